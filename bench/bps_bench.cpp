@@ -0,0 +1,345 @@
+// Throughput benchmarks for bps.
+//
+// Starts a stand-in network on loopback (open ports that accept, refused ports with nothing
+// bound, and blackholed ports whose listen queue is full so SYNs are dropped), scans it with
+// `Scanner` at each timing template and checks the results against the known port map. A few
+// microbenchmarks time the hot paths on their own.
+//
+//     bps_bench --hosts 16 --ports 2000 --timings 0-6
+
+#include <boost/asio.hpp>
+#include <boost/program_options.hpp>
+
+#include "scanner/scanner.h"
+#include "config/config.h"
+#include "config/port_list.h"
+#include "scanner/fingerprint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace po = boost::program_options;
+
+namespace {
+    // Below the ephemeral port ranges of Linux and Windows, so the scanner's own outgoing
+    // connections never collide with the farm.
+    constexpr int FIRST_PORT = 20000;
+    // The farm uses 127.0.0.2 onwards and leaves 127.0.0.1 to whatever else runs locally.
+    constexpr const char* FIRST_HOST = "127.0.0.2";
+
+    enum class Expected {
+        Open,
+        Refused,
+        Blackholed,
+        // The listener couldn't be created, so the port isn't checked.
+        Skipped
+    };
+
+    Expected expectedFor(std::size_t host, int port) {
+        /**
+         * @brief The deterministic port map: about 1 port in 20 is open and 1 in 500 is blackholed.
+         */
+        std::uint32_t hash = static_cast<std::uint32_t>(host * 2654435761u) ^ static_cast<std::uint32_t>(port * 40503u);
+        hash ^= hash >> 13;
+        hash *= 0x5bd1e995u;
+        hash ^= hash >> 15;
+        if (hash % 500 == 0) {
+            return Expected::Blackholed;
+        }
+        return hash % 20 == 0 ? Expected::Open : Expected::Refused;
+    }
+
+    // The stand-in network. Listeners run on their own io_context and thread so the farm
+    // never competes with the scanner's reactor.
+    class LoopbackFarm {
+    public:
+        LoopbackFarm(std::size_t hostCount, int portCount)
+            : hostCount(hostCount),
+            portCount(portCount),
+            expected(hostCount * portCount, Expected::Refused),
+            work(boost::asio::make_work_guard(ctx))
+        {
+            boost::asio::ip::address_v4 first = boost::asio::ip::make_address_v4(FIRST_HOST);
+            for (std::size_t host = 0; host < hostCount; ++host) {
+                boost::asio::ip::address address = boost::asio::ip::address_v4(first.to_uint() + static_cast<std::uint32_t>(host));
+                for (int i = 0; i < portCount; ++i) {
+                    Expected& slot = expected[host * portCount + i];
+                    slot = expectedFor(host, FIRST_PORT + i);
+                    if (slot != Expected::Refused && !listen(boost::asio::ip::tcp::endpoint(address, static_cast<std::uint16_t>(FIRST_PORT + i)), slot)) {
+                        slot = Expected::Skipped;
+                    }
+                }
+            }
+            thread = std::thread([this]() { ctx.run(); });
+        }
+
+        ~LoopbackFarm() {
+            work.reset();
+            ctx.stop();
+            thread.join();
+        }
+
+        Expected at(std::size_t host, int portOffset) const {
+            return expected[host * portCount + portOffset];
+        }
+
+        std::size_t count(Expected kind) const {
+            return static_cast<std::size_t>(std::count(expected.begin(), expected.end(), kind));
+        }
+
+    private:
+        bool listen(const boost::asio::ip::tcp::endpoint& endpoint, Expected kind) {
+            /**
+             * @brief Opens a listener for an open or blackholed port.
+             *
+             * A blackholed port listens with the smallest backlog and never accepts. Two
+             * connects fill its queue, after which the kernel drops every further SYN, which
+             * looks exactly like a filtering firewall to the scanner.
+             */
+            boost::system::error_code ec;
+            auto acceptor = std::make_unique<boost::asio::ip::tcp::acceptor>(ctx);
+            acceptor->open(endpoint.protocol(), ec);
+            if (!ec) {
+                acceptor->set_option(boost::asio::socket_base::reuse_address(true), ec);
+                acceptor->bind(endpoint, ec);
+            }
+            if (!ec) {
+                acceptor->listen(kind == Expected::Blackholed ? 0 : boost::asio::socket_base::max_listen_connections, ec);
+            }
+            if (ec) {
+                return false;
+            }
+            if (kind == Expected::Open) {
+                accept(*acceptor);
+            }
+            else {
+                for (int i = 0; i < 2; ++i) {
+                    fillers.push_back(std::make_unique<boost::asio::ip::tcp::socket>(ctx));
+                    fillers.back()->async_connect(endpoint, [](const boost::system::error_code&) {});
+                }
+            }
+            acceptors.push_back(std::move(acceptor));
+            return true;
+        }
+
+        void accept(boost::asio::ip::tcp::acceptor& acceptor) {
+            acceptor.async_accept([this, &acceptor](const boost::system::error_code& ec, boost::asio::ip::tcp::socket socket) {
+                if (ec == boost::asio::error::operation_aborted) {
+                    return;
+                }
+                boost::system::error_code ignore;
+                socket.close(ignore);
+                accept(acceptor);
+                });
+        }
+
+        std::size_t hostCount;
+        int portCount;
+        std::vector<Expected> expected;
+        boost::asio::io_context ctx;
+        boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+        std::vector<std::unique_ptr<boost::asio::ip::tcp::acceptor>> acceptors;
+        std::vector<std::unique_ptr<boost::asio::ip::tcp::socket>> fillers;
+        std::thread thread;
+    };
+
+    std::size_t peakRssKiB() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return counters.PeakWorkingSetSize / 1024;
+        }
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<std::size_t>(usage.ru_maxrss);
+#endif
+    }
+
+    void raiseDescriptorLimit() {
+        /**
+         * @brief Lifts the open file limit to its hard maximum; every listener and probe is a descriptor.
+         */
+#ifndef _WIN32
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+#endif
+    }
+
+    Config benchConfig(std::size_t hostCount, int portCount, int timing, int threads) {
+        /**
+         * @brief The configuration of a connect scan over the whole farm.
+         */
+        Config config = Config::defaults();
+        config.targetString = std::string(FIRST_HOST) + "-" + std::to_string(1 + hostCount);
+        config.startPort = FIRST_PORT;
+        config.endPort = FIRST_PORT + portCount - 1;
+        config.ports = portRange(config.startPort, config.endPort);
+        config.timing = timing;
+        config.scanMode = "connect";
+        config.threadCount = threads;
+        return config;
+    }
+
+    void benchmarkScan(const LoopbackFarm& farm, std::size_t hostCount, int portCount, int timing, int threads) {
+        /**
+         * @brief Scans the farm at one timing template and prints a row of the results table.
+         */
+        Scanner scanner(benchConfig(hostCount, portCount, timing, threads));
+        scanner.metrics = std::make_unique<ScanMetrics>(scanner.targets.size());
+        auto start = std::chrono::steady_clock::now();
+        scanner.scan();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::size_t missed = 0;
+        std::size_t falseOpen = 0;
+        for (std::size_t host = 0; host < hostCount; ++host) {
+            std::vector<bool> reported(portCount, false);
+            for (const PortInfo& portInfo : scanner.results->portsFor(host)) {
+                int offset = portInfo.port - FIRST_PORT;
+                if (portInfo.status == PortState::Open && offset >= 0 && offset < portCount) {
+                    reported[offset] = true;
+                }
+            }
+            for (int offset = 0; offset < portCount; ++offset) {
+                Expected expected = farm.at(host, offset);
+                if (expected == Expected::Open && !reported[offset]) {
+                    missed++;
+                }
+                else if ((expected == Expected::Refused || expected == Expected::Blackholed) && reported[offset]) {
+                    falseOpen++;
+                }
+            }
+        }
+
+        const LatencyHistogram& latency = scanner.metrics->overall();
+        std::uint64_t sent = scanner.metrics->sent.load();
+        std::printf("T%-4d %8.2f %10.0f %9.2f %9.2f %10lld %8llu %8llu %7zu %7zu %11zu\n",
+            timing, seconds, seconds > 0 ? sent / seconds : 0.0,
+            latency.quantile(0.5).count() / 1000.0, latency.quantile(0.99).count() / 1000.0,
+            static_cast<long long>(scanner.metrics->peakInFlight.load()),
+            static_cast<unsigned long long>(scanner.metrics->timeouts.load()),
+            static_cast<unsigned long long>(scanner.metrics->throttles.load()),
+            missed, falseOpen, peakRssKiB());
+        std::fflush(stdout);
+    }
+
+    template <typename Fn>
+    double nanosecondsPerOp(std::size_t iterations, Fn fn) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; ++i) {
+            fn(i);
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(iterations);
+    }
+
+    void runMicrobenchmarks(std::size_t hostCount, int portCount) {
+        /**
+         * @brief Times the per port and per probe bookkeeping without touching the network.
+         */
+        Scanner scanner(benchConfig(hostCount, portCount, 3, 1));
+        scanner.metrics = std::make_unique<ScanMetrics>(scanner.targets.size());
+        ScanShard shard(0, 1, scanner.targets.size(), scanner.ports, scanner.timingTemplate, 1);
+        std::size_t ports = scanner.ports.size();
+        std::size_t probes = scanner.targets.size() * ports;
+
+        double record = nanosecondsPerOp(probes, [&](std::size_t i) {
+            scanner.updateDictionary(shard, i / ports, PortInfo{ scanner.ports[i % ports], PortState::Open });
+            });
+        double duplicate = nanosecondsPerOp(probes, [&](std::size_t i) {
+            scanner.updateDictionary(shard, i / ports, PortInfo{ scanner.ports[i % ports], PortState::Open });
+            });
+
+        std::size_t checksum = 0;
+        double service = nanosecondsPerOp(std::size_t(1) << 22, [&](std::size_t i) {
+            checksum += getServiceNameForPort(static_cast<int>(i & 0xFFFF)).size();
+            });
+
+        double setup = nanosecondsPerOp(probes, [&](std::size_t) {
+            ProbeSlot* slot = shard.probePool.acquire();
+            std::optional<Probe> probe = shard.probeSource.next(slot->id);
+            if (probe) {
+                slot->targetIndex = probe->targetIndex;
+                slot->port = probe->port;
+            }
+            shard.probeSource.finish(slot->id);
+            shard.probePool.release(slot);
+            });
+
+        std::printf("\n%-38s %10s\n", "microbenchmark", "ns/op");
+        std::printf("%-38s %10.1f\n", "updateDictionary (new port)", record);
+        std::printf("%-38s %10.1f\n", "updateDictionary (duplicate)", duplicate);
+        std::printf("%-38s %10.1f\n", "getServiceNameForPort", service);
+        std::printf("%-38s %10.1f\n", "isOpen setup (slot + next probe)", setup);
+        if (checksum == 0) {
+            std::printf("(no service names)\n");
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::size_t hostCount;
+    int portCount;
+    std::string timingSpec;
+    int threads;
+    po::options_description desc("bps_bench Options");
+    desc.add_options()
+        ("help,h", "Displays this help message.")
+        ("hosts", po::value<std::size_t>(&hostCount)->default_value(16), "Set the amount of loopback hosts in the farm (default: 16).")
+        ("ports", po::value<int>(&portCount)->default_value(2000), "Set the amount of ports per host, starting at 20000 (default: 2000).")
+        ("timings", po::value<std::string>(&timingSpec)->default_value("0-6"), "Set the timing templates to benchmark, e.g. 3,5-6 (default: 0-6).")
+        ("threads,n", po::value<int>(&threads)->default_value(0), "Set the amount of scanner threads (default: one per core).");
+    po::variables_map vm;
+    std::vector<std::uint16_t> timings;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help")) {
+            std::cout << desc << "\n";
+            return 0;
+        }
+        po::notify(vm);
+        if (hostCount < 1 || hostCount > 250 || portCount < 1 || portCount > 45000) {
+            throw po::error("--hosts must be 1-250 and --ports 1-45000");
+        }
+        if (!parsePortList(timingSpec, timings) || std::any_of(timings.begin(), timings.end(), [](std::uint16_t timing) { return timing > 6; })) {
+            throw po::error("invalid timing list '" + timingSpec + "'");
+        }
+    }
+    catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n" << desc << "\n";
+        return 1;
+    }
+
+    // The scanner looks this logger up; keep it quiet so logging doesn't skew the numbers.
+    spdlog::stdout_color_mt("bps")->set_level(spdlog::level::err);
+    raiseDescriptorLimit();
+
+    LoopbackFarm farm(hostCount, portCount);
+    std::printf("farm: %zu hosts x %d ports, %zu open, %zu blackholed, %zu refused, %zu skipped\n\n",
+        hostCount, portCount, farm.count(Expected::Open), farm.count(Expected::Blackholed),
+        farm.count(Expected::Refused), farm.count(Expected::Skipped));
+    std::printf("%-5s %8s %10s %9s %9s %10s %8s %8s %7s %7s %11s\n",
+        "T", "seconds", "probes/s", "p50 ms", "p99 ms", "in flight", "timeout", "throttle", "missed", "false", "peak KiB");
+    for (std::uint16_t timing : timings) {
+        benchmarkScan(farm, hostCount, portCount, timing, threads);
+    }
+    runMicrobenchmarks(hostCount, portCount);
+    spdlog::shutdown();
+    return 0;
+}
@@ -9,7 +9,15 @@ int main(int argc, char** argv) {
 
     Config config = Config::load(argc, argv);
     Scanner scanner(config);
-    scanner.start();
+    if (!config.mergeFiles.empty()) {
+        scanner.merge();
+    }
+    else if (config.watchInterval > 0) {
+        scanner.watch();
+    }
+    else {
+        scanner.start();
+    }
     spdlog::shutdown();
     return 0;
 }
\ No newline at end of file
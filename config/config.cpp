@@ -1,4 +1,5 @@
 #include "config.h"
+#include "port_list.h"
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 
@@ -9,6 +10,18 @@ void Config::sanitize() noexcept {
     * 1. Ensures the endport doesnt go above 65355 or bellow 0
     * 2. If the starting port is greater then the endport, the endPort is adjusted to 65355
     * 3. Timing are stablized the maximum value of 6
+    * 4. Unknown scan modes fall back to a connect scan
+    * 5. Negative thread counts fall back to one thread per core
+    * 6. At least one DNS lookup is allowed in flight
+    * 7. --top-ports is capped at the size of the ranked port table
+    * 8. Unknown output formats fall back to JSON Lines
+    * 9. Checkpoints are written at most once a second
+    * 10. Banner reads wait at least a millisecond
+    * 11. Negative status intervals turn the status line off
+    * 12. Negative rate caps turn the cap off
+    * 13. Negative watch intervals scan once, a full sweep runs at most every round, and watch scans skip checkpoints
+    * 14. Negative retry pass counts turn the retry passes off
+    * 15. Negative per host connection caps fall back to the default share of the connection budget
     * 
     */
     auto logger = spdlog::stdout_color_mt("bps");
@@ -34,6 +47,82 @@ void Config::sanitize() noexcept {
         logger->debug("Timing value {} exceeds maximum allowed (6); adjusting timing to 6.", timing);
         timing = 6;
     }
+
+    if (scanMode != "connect" && scanMode != "syn") {
+        logger->debug("Unknown scan mode '{}'; falling back to a connect scan.", scanMode);
+        scanMode = "connect";
+    }
+
+    if (threadCount < 0) {
+        logger->debug("Thread count {} is below minimum (0); using one thread per core.", threadCount);
+        threadCount = 0;
+    }
+
+    if (dnsConcurrency < 1) {
+        logger->debug("DNS concurrency {} is below minimum (1); adjusting it to 1.", dnsConcurrency);
+        dnsConcurrency = 1;
+    }
+
+    if (topPortCount > rankedPortCount()) {
+        logger->warn("Top ports value {} exceeds the {} ranked ports; scanning those {} only.", topPortCount, rankedPortCount(), rankedPortCount());
+        topPortCount = rankedPortCount();
+    }
+
+    if (outputFormat != "jsonl" && outputFormat != "csv" && outputFormat != "grep") {
+        logger->debug("Unknown output format '{}'; falling back to jsonl.", outputFormat);
+        outputFormat = "jsonl";
+    }
+
+    if (checkpointInterval < 1) {
+        logger->debug("Checkpoint interval {} is below minimum (1); adjusting it to 1 second.", checkpointInterval);
+        checkpointInterval = 1;
+    }
+
+    if (bannerTimeout < 1) {
+        logger->debug("Banner timeout {} is below minimum (1); adjusting it to 1 millisecond.", bannerTimeout);
+        bannerTimeout = 1;
+    }
+
+    if (statsInterval < 0) {
+        logger->debug("Stats interval {} is below minimum (0); turning the status line off.", statsInterval);
+        statsInterval = 0;
+    }
+
+    if (maxRate < 0) {
+        logger->debug("Max rate {} is below minimum (0); scanning without a global rate cap.", maxRate);
+        maxRate = 0;
+    }
+
+    if (maxHostRate < 0) {
+        logger->debug("Max host rate {} is below minimum (0); scanning without a per host rate cap.", maxHostRate);
+        maxHostRate = 0;
+    }
+
+    if (watchInterval < 0) {
+        logger->debug("Watch interval {} is below minimum (0); scanning once.", watchInterval);
+        watchInterval = 0;
+    }
+
+    if (fullSweepRounds < 1) {
+        logger->debug("Full sweep interval {} is below minimum (1); probing every port every round.", fullSweepRounds);
+        fullSweepRounds = 1;
+    }
+
+    if (watchInterval > 0 && (!checkpointFile.empty() || !resumeFile.empty())) {
+        logger->debug("Watch scans keep their progress in --state-file; ignoring --checkpoint and --resume.");
+        checkpointFile.clear();
+        resumeFile.clear();
+    }
+
+    if (retryPasses < 0) {
+        logger->debug("Retry passes {} is below minimum (0); not retrying timed out probes.", retryPasses);
+        retryPasses = 0;
+    }
+
+    if (maxHostConnections < 0) {
+        logger->debug("Max host connections {} is below minimum (0); using the default share of the connection budget.", maxHostConnections);
+        maxHostConnections = 0;
+    }
 }
 
 Config Config::load(int argc, char** argv) {
@@ -45,18 +134,7 @@ Config Config::load(int argc, char** argv) {
     */
     Config config;
 
-    // Define command-line options using Boost Program Options
-    po::options_description desc("bps (https://github.com/Drew-Alleman/bps) Options");
-    desc.add_options()
-        ("help,h", "Displays this help message.")
-        ("target,t", po::value<std::string>(&config.targetString)->required(), "Specify one or more target IPv4 addresses to scan (comma-separated list).")
-        ("fast,F", po::bool_switch(&config.isFastMode)->default_value(false), "Enable fast scan mode: only scan the top 1024 most common ports.")
-        ("debug,d", po::bool_switch(&config.isDebugMode)->default_value(false), "Enable debug logging (dev and contributor logs)")
-        ("verbose,v", po::bool_switch(&config.isVerboseMode)->default_value(false), "Enable verbose logging (provides additional information)")
-        ("start,s", po::value<int>(&config.startPort)->default_value(1), "Set the starting port number for the scan (default: 1).")
-        ("end,e", po::value<int>(&config.endPort)->default_value(10000), "Set the ending port number for the scan (default: 10000).")
-        ("timing,T", po::value<int>(&config.timing)->default_value(3), "Set timing template from 0-6 (default is 3)")
-        ("closed,C", po::bool_switch(&config.displayClosedPorts)->default_value(false), "Includes the closed ports on a target in the output.");
+    po::options_description desc = options(config);
 
     po::variables_map vm;
     try {
@@ -69,6 +147,39 @@ Config Config::load(int argc, char** argv) {
         }
 
         po::notify(vm);
+
+        if (config.targetString.empty() && config.inputFile.empty() && config.mergeFiles.empty()) {
+            throw po::error("at least one of '--target' or '--input-file' is required");
+        }
+
+        if (!config.mergeFiles.empty() && (!config.targetString.empty() || !config.inputFile.empty())) {
+            throw po::error("'--merge' reports on the targets in its files and can't be combined with '--target' or '--input-file'");
+        }
+
+        if (!config.portSpec.empty() && !parsePortList(config.portSpec, config.ports)) {
+            throw po::error("invalid port list '" + config.portSpec + "'");
+        }
+
+        config.shardIndex = 0;
+        config.shardCount = 1;
+        if (!config.shardSpec.empty()) {
+            std::size_t slash = config.shardSpec.find('/');
+            try {
+                config.shardIndex = std::stoul(config.shardSpec.substr(0, slash));
+                config.shardCount = std::stoul(config.shardSpec.substr(slash == std::string::npos ? config.shardSpec.size() : slash + 1));
+            }
+            catch (std::exception&) {
+                config.shardIndex = 0;
+            }
+            if (config.shardIndex < 1 || config.shardIndex > config.shardCount) {
+                throw po::error("invalid shard '" + config.shardSpec + "', expected i/N with 1 <= i <= N");
+            }
+            config.shardIndex--;
+        }
+
+        if (!parsePortList(config.discoveryPortSpec, config.discoveryPorts) || config.discoveryPorts.empty()) {
+            throw po::error("invalid discovery port list '" + config.discoveryPortSpec + "'");
+        }
     }
     catch (std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
@@ -83,5 +194,84 @@ Config Config::load(int argc, char** argv) {
     // Sanitize the configuration values
     config.sanitize();
 
+    // An explicit port list wins over --top-ports, which wins over the port range.
+    if (config.portSpec.empty()) {
+        config.ports = config.topPortCount > 0 ? topPorts(config.topPortCount) : portRange(config.startPort, config.endPort);
+    }
+
+    return config;
+}
+
+po::options_description Config::options(Config& config) {
+    /*
+    * @brief Describes every command line option
+    *
+    * @param[out] config Receives the option values once they are parsed
+    * @return The options, ready for parsing or printing as help
+    */
+    po::options_description desc("bps (https://github.com/Drew-Alleman/bps) Options");
+    desc.add_options()
+        ("help,h", "Displays this help message.")
+        ("target,t", po::value<std::string>(&config.targetString), "Specify one or more targets to scan (comma-separated list of IPv4 addresses, CIDR blocks like 10.0.0.0/16, ranges like 10.0.0.1-254, or domains).")
+        ("input-file,i", po::value<std::string>(&config.inputFile), "Read targets from a file, one address, CIDR block, range or domain per line.")
+        ("fast,F", po::bool_switch(&config.isFastMode)->default_value(false), "Enable fast scan mode: only scan ports 1-1024.")
+        ("debug,d", po::bool_switch(&config.isDebugMode)->default_value(false), "Enable debug logging (dev and contributor logs)")
+        ("verbose,v", po::bool_switch(&config.isVerboseMode)->default_value(false), "Enable verbose logging (provides additional information)")
+        ("start,s", po::value<int>(&config.startPort)->default_value(1), "Set the starting port number for the scan (default: 1).")
+        ("end,e", po::value<int>(&config.endPort)->default_value(10000), "Set the ending port number for the scan (default: 10000).")
+        ("ports,p", po::value<std::string>(&config.portSpec), "Scan a list of ports and ranges instead of --start to --end, e.g. 22,80,443,8000-9000.")
+        ("top-ports", po::value<int>(&config.topPortCount)->default_value(0), "Scan the N most commonly open ports, most likely first (at most 240).")
+        ("timing,T", po::value<int>(&config.timing)->default_value(3), "Set timing template from 0-6 (default is 3)")
+        ("mode,m", po::value<std::string>(&config.scanMode)->default_value("connect"), "Set the scan engine: connect (default) or syn (half-open raw socket scan, Linux only, needs CAP_NET_RAW)")
+        ("hosts-file", po::value<std::string>(&config.hostsFile), "Resolve domains from a hosts file (address followed by names) before asking DNS.")
+        ("dns-concurrency", po::value<int>(&config.dnsConcurrency)->default_value(16), "Set the maximum amount of DNS lookups in flight (default: 16).")
+        ("threads,n", po::value<int>(&config.threadCount)->default_value(0), "Set the amount of threads running the scan (default: one per core).")
+        ("sharded", po::bool_switch(&config.isShardedMode)->default_value(false), "Give every thread its own event loop and slice of the ports instead of sharing one (scales better on many cores).")
+        ("output,o", po::value<std::string>(&config.outputFile), "Stream every result to a file as it is discovered (- for stdout, which replaces the report).")
+        ("output-format", po::value<std::string>(&config.outputFormat)->default_value("jsonl"), "Set the format used by --output: jsonl (default), csv or grep.")
+        ("checkpoint", po::value<std::string>(&config.checkpointFile), "Periodically save the scan progress and results to a file.")
+        ("checkpoint-interval", po::value<int>(&config.checkpointInterval)->default_value(30), "Set the seconds between checkpoints (default: 30).")
+        ("resume", po::value<std::string>(&config.resumeFile), "Continue the scan saved in a checkpoint file; run it with the same targets and ports.")
+        ("banners,b", po::bool_switch(&config.isBannerMode)->default_value(false), "Identify the service on each open port from its banner (connect scans only).")
+        ("banner-timeout", po::value<int>(&config.bannerTimeout)->default_value(1000), "Set how long to wait for a banner in milliseconds (default: 1000).")
+        ("signatures", po::value<std::string>(&config.signatureFile), "Load extra service signatures (a service name, a tab and the pattern per line), checked before the built in ones.")
+        ("services", po::value<std::string>(&config.servicesFile), "Name the usual service of each port from an nmap-services style file instead of the built in list.")
+        ("max-rate", po::value<int>(&config.maxRate)->default_value(0), "Send at most N probes per second in total (default: 0, no cap).")
+        ("max-host-rate", po::value<int>(&config.maxHostRate)->default_value(0), "Send at most N probes per second to any single target (default: 0, no cap).")
+        ("max-host-connections", po::value<int>(&config.maxHostConnections)->default_value(0), "Keep at most N probes in flight to any single target, fewer while it times out (default: 0, an eighth of the connection budget, or an even share with fewer targets).")
+        ("source-address", po::value<std::string>(&config.sourceAddressSpec), "Spread the connects over these local addresses (comma separated); each adds its own range of ephemeral ports.")
+        ("retry-passes", po::value<int>(&config.retryPasses)->default_value(1), "Probe the ports that timed out on hosts that answered again in up to N slower passes after the scan (default: 1).")
+        ("randomize,r", po::bool_switch(&config.isRandomOrder)->default_value(false), "Probe the targets and ports in a shuffled order that spreads the load over every host.")
+        ("seed", po::value<std::uint64_t>(&config.seed)->default_value(0), "Set the seed of the shuffled order so a scan can be repeated (default: 0, a random seed).")
+        ("shard", po::value<std::string>(&config.shardSpec), "Scan only slice i of N of the targets and ports, e.g. 2/4; run one process per slice with the same options.")
+        ("merge", po::value<std::vector<std::string>>(&config.mergeFiles)->multitoken(), "Combine the --output files (any format) of earlier scans or shards into one report instead of scanning.")
+        ("discover", po::bool_switch(&config.isDiscoveryMode)->default_value(false), "Probe a few common ports on every target first and only scan the hosts that answer (open or refused).")
+        ("discovery-ports", po::value<std::string>(&config.discoveryPortSpec)->default_value("21,22,25,80,135,139,443,445,3389,8080"), "Set the ports probed by --discover.")
+        ("stats-interval", po::value<int>(&config.statsInterval)->default_value(0), "Print a status line with live scan metrics to stderr every N seconds (default: 0, off).")
+        ("stats-file", po::value<std::string>(&config.statsFile), "Write the final scan metrics and latency histograms to a file as JSON (- for stdout).")
+        ("watch", po::value<int>(&config.watchInterval)->default_value(0), "Scan again every N seconds and only report the ports that opened, closed or turned filtered (default: 0, scan once).")
+        ("full-every", po::value<int>(&config.fullSweepRounds)->default_value(12), "Probe every port on every --watch round N; the rounds in between only probe open, filtered and recently changed ports (default: 12).")
+        ("watch-rounds", po::value<int>(&config.watchRounds)->default_value(0), "Stop --watch after N rounds (default: 0, run until interrupted).")
+        ("state-file", po::value<std::string>(&config.stateFile), "Keep the port states of --watch in a file, so a restarted watch reports what changed while it was down.")
+        ("closed,C", po::bool_switch(&config.displayClosedPorts)->default_value(false), "Includes the closed ports on a target in the output.");
+    return desc;
+}
+
+Config Config::defaults() {
+    /*
+    * @brief Builds the configuration of a command line that names no options
+    *
+    * Meant for embedding the scanner: the caller sets the targets and whatever else it needs.
+    * Nothing is sanitized, so out of range values set by the caller are used as given.
+    */
+    Config config;
+    po::options_description desc = options(config);
+    po::variables_map vm;
+    po::store(po::command_line_parser(std::vector<std::string>()).options(desc).run(), vm);
+    po::notify(vm);
+    config.shardIndex = 0;
+    config.shardCount = 1;
+    parsePortList(config.discoveryPortSpec, config.discoveryPorts);
+    config.ports = portRange(config.startPort, config.endPort);
     return config;
 }
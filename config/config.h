@@ -2,7 +2,9 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <boost/program_options.hpp>
 
@@ -10,19 +12,75 @@ namespace po = boost::program_options;
 
 struct Config {
     std::string targetString;
+    std::string inputFile;
+    std::string hostsFile;
+    int dnsConcurrency;
     int startPort;
     int endPort;
+    std::string portSpec;
+    int topPortCount;
+    // The ports to probe, resolved from `portSpec`, `topPortCount` or the start and end port.
+    std::vector<std::uint16_t> ports;
     int timing;
+    std::string scanMode;
+    int threadCount;
+    bool isShardedMode;
     bool isFastMode;
     bool isDebugMode;
     bool isVerboseMode;
     bool displayClosedPorts;
+    std::string outputFile;
+    std::string outputFormat;
+    std::string checkpointFile;
+    std::string resumeFile;
+    int checkpointInterval;
+    bool isBannerMode;
+    int bannerTimeout;
+    std::string signatureFile;
+    std::string servicesFile;
+    int statsInterval;
+    int maxRate;
+    int maxHostRate;
+    // Probes any single target may have in flight, 0 for an eighth of the connection budget
+    // (an even share of it with fewer than 8 targets).
+    int maxHostConnections;
+    // Local addresses the connects are spread over (comma separated), empty for the default route.
+    std::string sourceAddressSpec;
+    // Passes over the probes that timed out or failed, run after the main pass.
+    int retryPasses;
+    bool isRandomOrder;
+    std::uint64_t seed;
+    // This process's slice of a scan split over several processes, parsed from `shardSpec` ("i/N").
+    std::string shardSpec;
+    std::size_t shardIndex;
+    std::size_t shardCount;
+    // Result files of earlier scans to combine into one report instead of scanning.
+    std::vector<std::string> mergeFiles;
+    bool isDiscoveryMode;
+    std::string discoveryPortSpec;
+    // The ports probed by host discovery, resolved from `discoveryPortSpec`.
+    std::vector<std::uint16_t> discoveryPorts;
+    std::string statsFile;
+    // Seconds between the rounds of a watch scan, 0 to scan once.
+    int watchInterval;
+    // Every how many rounds a watch scan probes every port instead of only the ones that matter.
+    int fullSweepRounds;
+    // The rounds a watch scan runs before exiting, 0 to run until interrupted.
+    int watchRounds;
+    // Where a watch scan keeps the last known state of its ports between rounds and runs.
+    std::string stateFile;
 
     // Sanitize the configuration values
     void sanitize() noexcept;
 
     // Load config from command-line arguments and sanitize
     static Config load(int argc, char** argv);
+
+    // The command line defaults, for embedding the scanner without a command line
+    static Config defaults();
+
+    // Describes the command line options, storing their values in `config`
+    static po::options_description options(Config& config);
 };
 
 #endif // CONFIG_H
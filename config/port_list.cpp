@@ -0,0 +1,99 @@
+#include "port_list.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <iterator>
+#include <sstream>
+
+namespace {
+    // TCP ports ordered by how often they are found open, most common first, without duplicates.
+    constexpr std::uint16_t PORTS_BY_FREQUENCY[] = {
+        80, 23, 443, 21, 22, 25, 3389, 110, 445, 139, 143, 53, 135, 3306, 8080, 1723,
+        111, 995, 993, 5900, 1025, 587, 8888, 199, 1720, 465, 548, 113, 81, 6001, 10000, 514,
+        5060, 179, 1026, 2000, 8443, 8000, 32768, 554, 26, 1433, 49152, 2001, 515, 8008, 49154, 1027,
+        5666, 646, 5000, 5631, 631, 49153, 8081, 2049, 88, 79, 5800, 106, 2121, 1110, 49155, 6000,
+        513, 990, 5357, 427, 49156, 543, 544, 5101, 144, 7, 389, 8009, 3128, 444, 9999, 5009,
+        7070, 5190, 3000, 5432, 1900, 3986, 13, 1029, 9, 5051, 6646, 49157, 1028, 873, 1755, 2717,
+        4899, 9100, 119, 37, 1000, 3001, 5001, 82, 10010, 1030, 9090, 2107, 1024, 2103, 6004, 1801,
+        5050, 19, 8031, 1041, 255, 2967, 1049, 1048, 1053, 3703, 1056, 1065, 1064, 1054, 17, 808,
+        3689, 1031, 1044, 1071, 5901, 100, 9102, 8010, 2869, 1039, 5120, 4001, 9000, 2105, 636, 1038,
+        2601, 7000, 1, 1069, 1066, 625, 311, 280, 254, 4000, 5003, 1761, 2002, 2005, 1998, 1032,
+        1050, 6112, 3690, 1521, 2161, 6002, 1080, 2401, 902, 4045, 787, 7937, 1058, 2383, 32771, 1059,
+        1040, 1033, 50000, 5555, 10001, 1494, 593, 2301, 3, 3268, 7938, 1234, 1022, 1074, 8002, 1036,
+        1035, 9001, 1037, 464, 497, 1935, 6666, 2003, 6543, 1352, 24, 3269, 1111, 407, 500, 20,
+        2006, 3260, 15000, 1218, 1034, 4444, 264, 2004, 33, 1042, 42510, 999, 3052, 1023, 1068, 222,
+        7100, 888, 563, 1717, 2008, 992, 32770, 5222, 2007, 6667, 1863, 6379, 27017, 9200, 11211, 5672,
+    };
+
+    bool parsePort(const std::string& text, int& port) {
+        /**
+         * @brief Parses a single port number between 0 and 65535.
+         *
+         * @return false if `text` is empty, not a number or out of range.
+         */
+        if (text.empty() || text.size() > 5 || !std::all_of(text.begin(), text.end(), ::isdigit)) {
+            return false;
+        }
+        port = std::stoi(text);
+        return port <= 65535;
+    }
+}
+
+bool parsePortList(const std::string& spec, std::vector<std::uint16_t>& ports) {
+    /**
+     * @brief Parses a comma separated list of ports and port ranges.
+     *
+     * @param spec The list as given with `-p`, e.g. "22,80,443,8000-9000".
+     * @param[out] ports The ports in the order they were given, without duplicates.
+     * @return false if an entry is not a port or a valid range.
+     */
+    std::bitset<65536> seen;
+    std::stringstream ss(spec);
+    std::string entry;
+    ports.clear();
+    while (std::getline(ss, entry, ',')) {
+        int first;
+        int last;
+        std::size_t dash = entry.find('-');
+        if (dash == std::string::npos) {
+            if (!parsePort(entry, first)) {
+                return false;
+            }
+            last = first;
+        }
+        else if (!parsePort(entry.substr(0, dash), first) || !parsePort(entry.substr(dash + 1), last) || last < first) {
+            return false;
+        }
+        for (int port = first; port <= last; ++port) {
+            if (!seen.test(port)) {
+                seen.set(port);
+                ports.push_back(static_cast<std::uint16_t>(port));
+            }
+        }
+    }
+    return !ports.empty();
+}
+
+std::vector<std::uint16_t> topPorts(int count) {
+    /**
+     * @brief Picks the most commonly open ports.
+     *
+     * @param count The amount of ports wanted, at most `rankedPortCount()`.
+     * @return The ports, most likely to be open first.
+     */
+    std::size_t wanted = static_cast<std::size_t>(std::clamp(count, 0, rankedPortCount()));
+    return std::vector<std::uint16_t>(std::begin(PORTS_BY_FREQUENCY), std::begin(PORTS_BY_FREQUENCY) + wanted);
+}
+
+int rankedPortCount() noexcept {
+    return static_cast<int>(std::size(PORTS_BY_FREQUENCY));
+}
+
+std::vector<std::uint16_t> portRange(int startPort, int endPort) {
+    std::vector<std::uint16_t> ports;
+    for (int port = startPort; port <= endPort; ++port) {
+        ports.push_back(static_cast<std::uint16_t>(port));
+    }
+    return ports;
+}
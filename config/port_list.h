@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parses an nmap style port list such as "22,80,443,8000-9000" into `ports`, keeping the
+// order given and dropping duplicates. Returns false on a malformed entry.
+bool parsePortList(const std::string& spec, std::vector<std::uint16_t>& ports);
+
+// The `count` most commonly open TCP ports, most likely first, never more than
+// `rankedPortCount()`.
+std::vector<std::uint16_t> topPorts(int count);
+
+// How many ports the embedded frequency table ranks.
+int rankedPortCount() noexcept;
+
+// Every port from `startPort` to `endPort`, in ascending order.
+std::vector<std::uint16_t> portRange(int startPort, int endPort);
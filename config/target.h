@@ -5,14 +5,15 @@
 class Target {
 public:
     std::string prettyName;
+    // The domain the target was given as, empty for plain addresses.
+    std::string hostname;
     boost::asio::ip::address address;
 
     Target(const boost::asio::ip::address& addr)
-        : address(addr), prettyName(addr.to_string()) {
+        : prettyName(addr.to_string()), address(addr) {
     }
 
     Target(const boost::asio::ip::address& addr, const std::string& pretty)
-        : address(addr), prettyName(pretty) {
-        prettyName = pretty + " (" + addr.to_string() + ")";
+        : prettyName(pretty + " (" + addr.to_string() + ")"), hostname(pretty), address(addr) {
     }
 };
@@ -0,0 +1,227 @@
+#include "target_space.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+    bool parseAddress(const std::string& text, std::uint32_t& address) {
+        /**
+         * @brief Parses a dotted IPv4 address.
+         *
+         * @param text The address, e.g. "10.0.0.1".
+         * @param[out] address The address in host byte order.
+         * @return false if `text` is not an IPv4 address.
+         */
+        boost::system::error_code ec;
+        boost::asio::ip::address_v4 parsed = boost::asio::ip::make_address_v4(text, ec);
+        if (ec) {
+            return false;
+        }
+        address = parsed.to_uint();
+        return true;
+    }
+
+    bool parseNumber(const std::string& text, std::uint32_t maximum, std::uint32_t& value) {
+        /**
+         * @brief Parses a small decimal number such as a prefix length or the last octet of a range.
+         *
+         * @return false if `text` is empty, not a number or above `maximum`.
+         */
+        if (text.empty() || text.size() > 3 || !std::all_of(text.begin(), text.end(), ::isdigit)) {
+            return false;
+        }
+        value = static_cast<std::uint32_t>(std::stoul(text));
+        return value <= maximum;
+    }
+}
+
+bool TargetSpace::addRange(const std::string& spec) {
+    /**
+     * @brief Adds the addresses of a single IPv4 address, a CIDR block or a dash range.
+     *
+     * A CIDR block starts at its network address, so 10.0.0.7/24 covers 10.0.0.0-10.0.0.255.
+     * A dash range may either give the full last address or only its last octet.
+     *
+     * @param spec The text given on the command line or in the input file.
+     * @return false if `spec` could not be parsed, in which case nothing is added.
+     */
+    std::uint32_t first;
+    std::size_t slash = spec.find('/');
+    if (slash != std::string::npos) {
+        std::uint32_t prefix;
+        if (!parseAddress(spec.substr(0, slash), first) || !parseNumber(spec.substr(slash + 1), 32, prefix)) {
+            return false;
+        }
+        std::uint64_t count = 1ULL << (32 - prefix);
+        appendRange(static_cast<std::uint32_t>(first & ~(count - 1)), count);
+        return true;
+    }
+
+    std::size_t dash = spec.find('-');
+    if (dash != std::string::npos) {
+        std::uint32_t last;
+        std::string end = spec.substr(dash + 1);
+        if (!parseAddress(spec.substr(0, dash), first)) {
+            return false;
+        }
+        std::uint32_t lastOctet;
+        if (parseNumber(end, 255, lastOctet)) {
+            last = (first & 0xFFFFFF00) | lastOctet;
+        }
+        else if (!parseAddress(end, last)) {
+            return false;
+        }
+        if (last < first) {
+            return false;
+        }
+        appendRange(first, static_cast<std::uint64_t>(last) - first + 1);
+        return true;
+    }
+
+    if (!parseAddress(spec, first)) {
+        return false;
+    }
+    appendRange(first, 1);
+    return true;
+}
+
+void TargetSpace::addHost(const Target& target) {
+    /**
+     * @brief Adds a target that keeps its own pretty name, like a resolved domain.
+     *
+     * @param target The target to add.
+     */
+    blocks.push_back({ total, 1, 0, static_cast<std::int64_t>(hosts.size()) });
+    hosts.emplace_back(target.prettyName, target, HostState::Resolved);
+    total++;
+}
+
+void TargetSpace::addPendingHost(const std::string& name) {
+    /**
+     * @brief Adds a domain whose address is filled in later by `resolveHost()`.
+     *
+     * @param name The domain as it was given.
+     */
+    blocks.push_back({ total, 1, 0, static_cast<std::int64_t>(hosts.size()) });
+    hosts.emplace_back(name, Target(boost::asio::ip::address_v4::any(), name), HostState::Pending);
+    total++;
+}
+
+std::size_t TargetSpace::hostCount() const {
+    return hosts.size();
+}
+
+const std::string& TargetSpace::hostName(std::size_t hostIndex) const {
+    return hosts[hostIndex].name;
+}
+
+void TargetSpace::resolveHost(std::size_t hostIndex, const boost::asio::ip::address& address) {
+    /**
+     * @brief Fills in the address of a pending host.
+     *
+     * The target is written before the state is released, so readers that see Resolved
+     * also see the address.
+     *
+     * @param hostIndex The host, in the order they were added.
+     * @param address The address the domain resolved to.
+     */
+    Host& host = hosts[hostIndex];
+    host.target = Target(address, host.name);
+    host.state.store(HostState::Resolved, std::memory_order_release);
+}
+
+TargetSpace::HostState TargetSpace::hostState(std::size_t hostIndex) const {
+    return hosts[hostIndex].state.load(std::memory_order_acquire);
+}
+
+void TargetSpace::failHost(std::size_t hostIndex) {
+    hosts[hostIndex].state.store(HostState::Failed, std::memory_order_release);
+}
+
+TargetSpace::HostState TargetSpace::stateAt(std::size_t index) const {
+    /**
+     * @brief Checks whether a target can be probed yet.
+     *
+     * @param index A target index below `size()`.
+     * @return Resolved for ranges and resolved hosts, otherwise the host's resolution state.
+     */
+    const Block& block = blockFor(index);
+    if (block.hostIndex < 0) {
+        return HostState::Resolved;
+    }
+    return hosts[block.hostIndex].state.load(std::memory_order_acquire);
+}
+
+std::int64_t TargetSpace::hostIndexAt(std::size_t index) const {
+    return blockFor(index).hostIndex;
+}
+
+void TargetSpace::appendRange(std::uint32_t firstAddress, std::uint64_t count) {
+    /**
+     * @brief Appends a run of addresses to the space.
+     *
+     * Addresses that directly follow the previous range are merged into it, so a sorted
+     * input file of single addresses costs one block per run rather than one per line.
+     *
+     * @param firstAddress The first address of the run in host byte order.
+     * @param count The amount of addresses in the run.
+     */
+    if (!blocks.empty()) {
+        Block& last = blocks.back();
+        if (last.hostIndex < 0 && last.firstAddress + last.count == firstAddress) {
+            last.count += count;
+            total += count;
+            return;
+        }
+    }
+    blocks.push_back({ total, count, firstAddress, -1 });
+    total += count;
+}
+
+std::size_t TargetSpace::size() const {
+    return total;
+}
+
+bool TargetSpace::empty() const {
+    return total == 0;
+}
+
+const TargetSpace::Block& TargetSpace::blockFor(std::size_t index) const {
+    /**
+     * @brief Binary searches the blocks for the one holding `index`.
+     *
+     * @param index A target index below `size()`.
+     * @return The block `index` falls into.
+     */
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), index,
+        [](std::size_t value, const Block& block) { return value < block.firstIndex; });
+    return *(it - 1);
+}
+
+boost::asio::ip::address TargetSpace::addressAt(std::size_t index) const {
+    /**
+     * @brief Fetches the address of a target; cheap enough to call for every probe.
+     *
+     * @param index A target index below `size()`.
+     * @return The target's address.
+     */
+    const Block& block = blockFor(index);
+    if (block.hostIndex >= 0) {
+        return hosts[block.hostIndex].target.address;
+    }
+    return boost::asio::ip::address_v4(static_cast<std::uint32_t>(block.firstAddress + (index - block.firstIndex)));
+}
+
+Target TargetSpace::at(std::size_t index) const {
+    /**
+     * @brief Builds the target at an index, including its pretty name.
+     *
+     * @param index A target index below `size()`.
+     * @return The target.
+     */
+    const Block& block = blockFor(index);
+    if (block.hostIndex >= 0) {
+        return hosts[block.hostIndex].target;
+    }
+    return Target(addressAt(index));
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "target.h"
+
+// Every target of a scan, stored as IPv4 address ranges plus individually added hosts.
+// CIDR blocks and dash ranges take constant space no matter how many addresses they
+// cover; targets are only built when `at()` is asked for one. Domains can be added before
+// they are resolved and filled in by the HostResolver while the scan is running.
+class TargetSpace {
+public:
+    enum class HostState : std::uint8_t {
+        Resolved,
+        Pending,
+        Failed
+    };
+
+    // Adds a single IPv4 address, a CIDR block (10.0.0.0/16) or a dash range (10.0.0.1-254
+    // or 10.0.0.1-10.0.1.20); returns false if `spec` is none of those.
+    bool addRange(const std::string& spec);
+    // Adds an individual host, e.g. an IPv6 address or a resolved domain name.
+    void addHost(const Target& target);
+    // Adds a domain that still has to be resolved.
+    void addPendingHost(const std::string& name);
+    // The amount of individually added hosts.
+    std::size_t hostCount() const;
+    // The domain of a host added with `addPendingHost()`.
+    const std::string& hostName(std::size_t hostIndex) const;
+    // Publishes the address of a pending host; safe while the scan reads the space.
+    void resolveHost(std::size_t hostIndex, const boost::asio::ip::address& address);
+    // The resolution state of a host, in the order they were added.
+    HostState hostState(std::size_t hostIndex) const;
+    // Marks a pending host as unresolvable.
+    void failHost(std::size_t hostIndex);
+    // Whether the target at `index` has an address yet; ranges are always resolved.
+    HostState stateAt(std::size_t index) const;
+    // The host behind the target at `index`, or -1 when it is part of a range.
+    std::int64_t hostIndexAt(std::size_t index) const;
+    // The amount of targets.
+    std::size_t size() const;
+    bool empty() const;
+    // Builds the target at `index`.
+    Target at(std::size_t index) const;
+    // The address of the target at `index`, without building its pretty name.
+    boost::asio::ip::address addressAt(std::size_t index) const;
+
+private:
+    // `count` consecutive targets starting at index `firstIndex`. Ranges start at
+    // `firstAddress`; a block with a `hostIndex` is the single entry of `hosts`.
+    struct Block {
+        std::size_t firstIndex;
+        std::uint64_t count;
+        std::uint32_t firstAddress;
+        std::int64_t hostIndex;
+    };
+
+    struct Host {
+        Host(const std::string& name, const Target& target, HostState state)
+            : name(name),
+            target(target),
+            state(state)
+        {
+        }
+
+        std::string name;
+        // Only read once `state` has left Pending.
+        Target target;
+        std::atomic<HostState> state;
+    };
+
+    // Appends `count` addresses starting at `firstAddress`, extending the last block when they follow it.
+    void appendRange(std::uint32_t firstAddress, std::uint64_t count);
+    // Finds the block holding `index`.
+    const Block& blockFor(std::size_t index) const;
+
+    std::vector<Block> blocks;
+    // A deque so hosts never move once added.
+    std::deque<Host> hosts;
+    std::size_t total = 0;
+};
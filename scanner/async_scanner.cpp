@@ -0,0 +1,35 @@
+#include "async_scanner.h"
+#include "scanner.h"
+
+AsyncScanner::AsyncScanner(const boost::asio::any_io_executor& executor, const Config& config)
+    : executor(executor),
+    scanner(std::make_unique<Scanner>(config))
+{
+}
+
+AsyncScanner::~AsyncScanner() = default;
+
+void AsyncScanner::start(ResultHandler onResult, std::function<void(boost::system::error_code)> onDone) {
+    /**
+     * @brief Hands the callbacks to the Scanner and starts it on `executor`.
+     *
+     * @param onResult Gets every recorded port.
+     * @param onDone Gets the outcome once the last probe has finished.
+     */
+    scanner->resultHandler = std::move(onResult);
+    scanner->startAsync(executor, [this, onDone = std::move(onDone)]() {
+        onDone(scanner->cancelled ? boost::system::error_code(boost::asio::error::operation_aborted) : boost::system::error_code());
+        });
+}
+
+void AsyncScanner::cancel() {
+    scanner->cancel();
+}
+
+const ResultStore& AsyncScanner::results() const {
+    return *scanner->results;
+}
+
+const TargetSpace& AsyncScanner::targets() const {
+    return scanner->targets;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <boost/version.hpp>
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <string_view>
+
+#include "config/config.h"
+#include "config/target.h"
+#include "config/target_space.h"
+#include "result_store.h"
+
+class Scanner;
+
+// Runs a scan inside another application, on that application's executor, so one process can
+// keep many scans going on a shared reactor instead of starting `bps` and parsing its output.
+// Ports reach a callback as they are found, and the scan completes through any Boost.Asio
+// completion token: a plain callback, `boost::asio::use_future`, or `boost::asio::use_awaitable`
+// in a C++20 coroutine:
+//
+//     Config config = Config::defaults();
+//     config.targetString = "10.0.0.0/24";
+//     AsyncScanner scan(co_await boost::asio::this_coro::executor, config);
+//     co_await scan.asyncScan([](const Target& target, PortInfo portInfo, std::string_view service) {
+//         ...
+//     }, boost::asio::use_awaitable);
+//
+// Each AsyncScanner runs one scan and must outlive it. Only connect scans run this way; the SYN
+// engine, checkpoints and the status line need the threads of the command line scanner.
+class AsyncScanner {
+public:
+    // Gets each port as it is recorded, on the strand of the probe that found it, so several
+    // calls can run at once when more than one thread runs the executor.
+    using ResultHandler = std::function<void(const Target& target, PortInfo portInfo, std::string_view service)>;
+
+    AsyncScanner(const boost::asio::any_io_executor& executor, const Config& config);
+    ~AsyncScanner();
+
+    AsyncScanner(const AsyncScanner&) = delete;
+    AsyncScanner& operator=(const AsyncScanner&) = delete;
+
+    // Starts the scan; completes with `void(boost::system::error_code)`, which is
+    // operation_aborted when the scan was cancelled. Can only be called once.
+    template <typename CompletionToken>
+    auto asyncScan(ResultHandler onResult, CompletionToken&& token) {
+        return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code)>(
+            [this](auto handler, ResultHandler onResult) {
+#if BOOST_VERSION >= 107700
+                auto slot = boost::asio::get_associated_cancellation_slot(handler);
+                if (slot.is_connected()) {
+                    slot.assign([this](boost::asio::cancellation_type) { cancel(); });
+                }
+#endif
+                // Keeps the handler's executor busy until the handler has run.
+                auto handlerExecutor = boost::asio::prefer(boost::asio::get_associated_executor(handler, executor),
+                    boost::asio::execution::outstanding_work.tracked);
+                // The scanner keeps its completion callback, so the work guard has to be dropped once used.
+                auto state = std::make_shared<std::pair<decltype(handler), std::optional<decltype(handlerExecutor)>>>(
+                    std::move(handler), std::move(handlerExecutor));
+                start(std::move(onResult), [state](boost::system::error_code ec) {
+                    auto workExecutor = std::move(*state->second);
+                    state->second.reset();
+                    boost::asio::post(workExecutor, [state, ec]() {
+                        std::move(state->first)(ec);
+                        });
+                    });
+            },
+            token, std::move(onResult));
+    }
+
+    // Stops the scan from any thread; it completes once the probes in flight have wound down.
+    void cancel();
+    // Every recorded port, complete once the scan has completed.
+    const ResultStore& results() const;
+    // Turns the target indexes of `results()` into targets.
+    const TargetSpace& targets() const;
+
+private:
+    void start(ResultHandler onResult, std::function<void(boost::system::error_code)> onDone);
+
+    boost::asio::any_io_executor executor;
+    std::unique_ptr<Scanner> scanner;
+};
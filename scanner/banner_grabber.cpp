@@ -0,0 +1,114 @@
+#include "banner_grabber.h"
+#include "socket_resources.h"
+
+#include <array>
+#include <cctype>
+#include <string_view>
+
+namespace {
+    // Most services answer this with something recognisable, even if it is only an error.
+    constexpr std::string_view FALLBACK_PROBE = "GET / HTTP/1.0\r\n\r\n";
+    // Enough for a greeting or a set of HTTP headers.
+    constexpr std::size_t MAX_BANNER = 4096;
+    // The longest banner line passed on to the callback.
+    constexpr std::size_t MAX_BANNER_LINE = 80;
+
+    std::string firstLine(std::string_view response) {
+        /**
+         * @brief The first line of a response with unprintable bytes replaced by dots.
+         */
+        std::string line;
+        for (char c : response) {
+            if (c == '\r' || c == '\n' || line.size() == MAX_BANNER_LINE) {
+                break;
+            }
+            line += std::isprint(static_cast<unsigned char>(c)) ? c : '.';
+        }
+        return line;
+    }
+}
+
+struct BannerGrabber::Session {
+    Session(boost::asio::ip::tcp::socket socket, Callback done)
+        : socket(std::move(socket)),
+        timer(this->socket.get_executor()),
+        done(std::move(done))
+    {
+    }
+
+    boost::asio::ip::tcp::socket socket;
+    // The read deadline.
+    boost::asio::steady_timer timer;
+    Callback done;
+    std::array<char, MAX_BANNER> buffer;
+    std::size_t received = 0;
+    bool probed = false;
+    // Bumped for every read so a stale deadline can't cancel the next one.
+    std::uint64_t generation = 0;
+};
+
+BannerGrabber::BannerGrabber(const ServiceMatcher& matcher, std::chrono::milliseconds readTimeout)
+    : matcher(matcher),
+    readTimeout(readTimeout)
+{
+}
+
+void BannerGrabber::grab(boost::asio::ip::tcp::socket socket, Callback done) const {
+    /**
+     * @brief Starts identifying the service on a connected socket.
+     *
+     * Everything runs on the socket's executor, so on a shared io_context the grab uses the
+     * strand of the probe slot the socket came from.
+     *
+     * @param socket A socket that has just connected to an open port.
+     * @param done Called once with the result, on the socket's executor.
+     */
+    read(std::make_shared<Session>(std::move(socket), std::move(done)));
+}
+
+void BannerGrabber::read(std::shared_ptr<Session> session) const {
+    /**
+     * @brief Reads whatever the service sends within the deadline.
+     *
+     * One read is enough for greetings and HTTP headers, and returning on the first bytes keeps
+     * talkative services from costing a full deadline each.
+     */
+    session->generation++;
+    session->timer.expires_after(readTimeout);
+    session->timer.async_wait([session, generation = session->generation](const boost::system::error_code& ec) {
+        if (!ec && session->generation == generation) {
+            boost::system::error_code ignore;
+            session->socket.cancel(ignore);
+        }
+        });
+    session->socket.async_read_some(boost::asio::buffer(session->buffer),
+        [this, session](const boost::system::error_code& ec, std::size_t bytes) {
+            session->generation++;
+            boost::system::error_code ignore;
+            session->timer.cancel(ignore);
+            session->received = bytes;
+            if (bytes == 0 && !session->probed && ec == boost::asio::error::operation_aborted) {
+                sendProbe(session);
+                return;
+            }
+            finish(*session);
+        });
+}
+
+void BannerGrabber::sendProbe(std::shared_ptr<Session> session) const {
+    session->probed = true;
+    boost::asio::async_write(session->socket, boost::asio::buffer(FALLBACK_PROBE.data(), FALLBACK_PROBE.size()),
+        [this, session](const boost::system::error_code& ec, std::size_t) {
+            if (ec) {
+                finish(*session);
+                return;
+            }
+            read(session);
+        });
+}
+
+void BannerGrabber::finish(Session& session) const {
+    std::string_view response(session.buffer.data(), session.received);
+    closeAbortively(session.socket);
+    session.done(matcher.match(response), firstLine(response));
+}
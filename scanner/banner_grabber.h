@@ -0,0 +1,38 @@
+#pragma once
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "service_matcher.h"
+
+// Identifies the service behind an open port from what it sends. The connect phase hands over
+// its connected socket, so the probe slot is free again straight away and banner reads never
+// hold back new connects. The service gets one read deadline to speak first; if it stays silent
+// a small HTTP request is sent and its answer gets another deadline. The connection is reset
+// afterwards, so it doesn't sit in TIME_WAIT.
+class BannerGrabber {
+public:
+    // Receives the matched service (empty if no signature matched) and the banner's first line.
+    using Callback = std::function<void(const std::string& service, const std::string& banner)>;
+
+    BannerGrabber(const ServiceMatcher& matcher, std::chrono::milliseconds readTimeout);
+
+    // Reads the banner from `socket` on its executor, then closes it and calls `done`.
+    void grab(boost::asio::ip::tcp::socket socket, Callback done) const;
+
+private:
+    struct Session;
+
+    // Waits up to `readTimeout` for the service to send something.
+    void read(std::shared_ptr<Session> session) const;
+    // Sends the fallback request to a service that didn't speak first.
+    void sendProbe(std::shared_ptr<Session> session) const;
+    // Matches what was received and hands the result to the callback.
+    void finish(Session& session) const;
+
+    const ServiceMatcher& matcher;
+    std::chrono::milliseconds readTimeout;
+};
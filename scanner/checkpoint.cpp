@@ -0,0 +1,143 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    // The last byte is the format version; a checkpoint of another version isn't read.
+    constexpr char MAGIC[8] = { 'B', 'P', 'S', 'C', 'K', 'P', 'T', '1' };
+
+    template <typename T>
+    void writeValue(std::ofstream& file, T value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    bool readValue(std::ifstream& file, T& value) {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+}
+
+bool Checkpoint::save(const std::string& path) const {
+    /**
+     * @brief Writes the checkpoint next to `path` and renames it into place.
+     *
+     * Layout: magic, fingerprint, seed, shard count, the shard cursors, a flag and count followed
+     * by the live targets of host discovery, the deferred probe count followed by a (target
+     * index, port) record per probe, result count, then one (target index, port, state) record
+     * per result. A scan killed mid-save leaves the previous checkpoint intact.
+     *
+     * @param path The checkpoint file.
+     * @return false if the file could not be written.
+     */
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file.write(MAGIC, sizeof(MAGIC));
+        writeValue<std::uint64_t>(file, fingerprint);
+        writeValue<std::uint64_t>(file, seed);
+        writeValue<std::uint64_t>(file, cursors.size());
+        for (std::uint64_t cursor : cursors) {
+            writeValue<std::uint64_t>(file, cursor);
+        }
+        writeValue<std::uint8_t>(file, liveTargets ? 1 : 0);
+        writeValue<std::uint64_t>(file, liveTargets ? liveTargets->size() : 0);
+        if (liveTargets) {
+            for (std::size_t targetIndex : *liveTargets) {
+                writeValue<std::uint64_t>(file, targetIndex);
+            }
+        }
+        writeValue<std::uint64_t>(file, deferred.size());
+        for (const TargetPort& probe : deferred) {
+            writeValue<std::uint64_t>(file, probe.targetIndex);
+            writeValue<std::uint16_t>(file, probe.port);
+        }
+        writeValue<std::uint64_t>(file, results.size());
+        for (const auto& [targetIndex, portInfo] : results) {
+            writeValue<std::uint64_t>(file, targetIndex);
+            writeValue<std::uint16_t>(file, static_cast<std::uint16_t>(portInfo.port));
+            writeValue<std::uint8_t>(file, static_cast<std::uint8_t>(portInfo.status));
+        }
+        if (!file.flush()) {
+            return false;
+        }
+    }
+#ifdef _WIN32
+    // rename() doesn't replace an existing file on Windows.
+    std::remove(path.c_str());
+#endif
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+std::optional<Checkpoint> Checkpoint::load(const std::string& path) {
+    /**
+     * @brief Reads a checkpoint file.
+     *
+     * @param path The checkpoint file.
+     * @return The checkpoint, or std::nullopt if it can't be read or isn't a checkpoint.
+     */
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if (!file || !file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        return std::nullopt;
+    }
+    Checkpoint checkpoint;
+    std::uint64_t shardCount;
+    if (!readValue(file, checkpoint.fingerprint) || !readValue(file, checkpoint.seed)) {
+        return std::nullopt;
+    }
+    if (!readValue(file, shardCount) || shardCount == 0 || shardCount > 65536) {
+        return std::nullopt;
+    }
+    checkpoint.cursors.resize(shardCount);
+    for (std::uint64_t& cursor : checkpoint.cursors) {
+        if (!readValue(file, cursor)) {
+            return std::nullopt;
+        }
+    }
+    std::uint8_t discovered;
+    std::uint64_t liveCount;
+    if (!readValue(file, discovered) || !readValue(file, liveCount)) {
+        return std::nullopt;
+    }
+    if (discovered) {
+        checkpoint.liveTargets.emplace();
+        for (std::uint64_t i = 0; i < liveCount; ++i) {
+            std::uint64_t targetIndex;
+            if (!readValue(file, targetIndex)) {
+                return std::nullopt;
+            }
+            checkpoint.liveTargets->push_back(static_cast<std::size_t>(targetIndex));
+        }
+    }
+    std::uint64_t deferredCount;
+    if (!readValue(file, deferredCount)) {
+        return std::nullopt;
+    }
+    for (std::uint64_t i = 0; i < deferredCount; ++i) {
+        std::uint64_t targetIndex;
+        std::uint16_t port;
+        if (!readValue(file, targetIndex) || !readValue(file, port)) {
+            return std::nullopt;
+        }
+        checkpoint.deferred.push_back({ static_cast<std::size_t>(targetIndex), port });
+    }
+    std::uint64_t resultCount;
+    if (!readValue(file, resultCount)) {
+        return std::nullopt;
+    }
+    for (std::uint64_t i = 0; i < resultCount; ++i) {
+        std::uint64_t targetIndex;
+        std::uint16_t port;
+        std::uint8_t state;
+        if (!readValue(file, targetIndex) || !readValue(file, port) || !readValue(file, state) || state > static_cast<std::uint8_t>(PortState::Unknown)) {
+            return std::nullopt;
+        }
+        checkpoint.results.push_back({ static_cast<std::size_t>(targetIndex), PortInfo{ port, static_cast<PortState>(state) } });
+    }
+    return checkpoint;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "probe_source.h"
+#include "result_store.h"
+
+// The state needed to continue an interrupted scan: how far each shard got, and the ports
+// found so far. Stored as a small binary file that is replaced atomically on every save.
+struct Checkpoint {
+    // Identifies the targets and ports of the scan, so a checkpoint is never applied to a different scan.
+    std::uint64_t fingerprint = 0;
+    // The seed of the shuffled probe order, 0 when the scan wasn't shuffled.
+    std::uint64_t seed = 0;
+    // Per shard, the probe index below which everything has finished.
+    std::vector<std::uint64_t> cursors;
+    // The targets that answered host discovery, if the scan ran it; the cursors walk only these.
+    std::optional<std::vector<std::size_t>> liveTargets;
+    // The probes put off to the retry passes, which the cursors already count as done.
+    std::vector<TargetPort> deferred;
+    // Every recorded port as (target index, port info).
+    std::vector<std::pair<std::size_t, PortInfo>> results;
+
+    // Writes the checkpoint to `path` through a temporary file; returns false on an I/O error.
+    bool save(const std::string& path) const;
+    // Reads a checkpoint written by `save()`, or nothing if the file is missing or malformed.
+    static std::optional<Checkpoint> load(const std::string& path);
+};
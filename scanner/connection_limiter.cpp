@@ -0,0 +1,76 @@
+#include "connection_limiter.h"
+
+#include <algorithm>
+
+void ConnectionLimiter::acquire(std::function<void()> onAcquired) {
+    /**
+     * @brief Requests a connection slot.
+     *
+     * If a slot is free the handler runs immediately on the calling thread, otherwise it is
+     * queued behind the other waiters and started by `release()`.
+     *
+     * @param onAcquired The work to run while holding the slot.
+     */
+    {
+        std::lock_guard<std::mutex> lock(limiterMutex);
+        if (active >= capacity) {
+            waiters.push_back(std::move(onAcquired));
+            return;
+        }
+        active++;
+    }
+    onAcquired();
+}
+
+void ConnectionLimiter::release() {
+    /**
+     * @brief Gives a connection slot back.
+     *
+     * The slot is transferred directly to the oldest waiter, which is posted to the
+     * executor so it never runs on the stack of the probe that just finished. If the
+     * capacity has shrunk below the slots in use, the slot is retired instead.
+     */
+    std::function<void()> next;
+    {
+        std::lock_guard<std::mutex> lock(limiterMutex);
+        if (waiters.empty() || active > capacity) {
+            active--;
+            return;
+        }
+        next = std::move(waiters.front());
+        waiters.pop_front();
+    }
+    boost::asio::post(executor, std::move(next));
+}
+
+void ConnectionLimiter::setCapacity(int newCapacity) {
+    /**
+     * @brief Resizes the limiter.
+     *
+     * Growing starts as many waiters as there are new slots. Shrinking never interrupts a
+     * running probe; extra slots are retired as their probes call `release()`.
+     *
+     * @param newCapacity The new amount of slots, at least 1.
+     */
+    std::vector<std::function<void()>> started;
+    {
+        std::lock_guard<std::mutex> lock(limiterMutex);
+        capacity = std::max(1, newCapacity);
+        while (active < capacity && !waiters.empty()) {
+            active++;
+            started.push_back(std::move(waiters.front()));
+            waiters.pop_front();
+        }
+    }
+    for (std::function<void()>& next : started) {
+        boost::asio::post(executor, std::move(next));
+    }
+}
+
+int ConnectionLimiter::inFlight() {
+    /**
+     * @brief The amount of slots currently held.
+     */
+    std::lock_guard<std::mutex> lock(limiterMutex);
+    return active;
+}
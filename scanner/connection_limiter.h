@@ -0,0 +1,36 @@
+#pragma once
+#include <boost/asio.hpp>
+
+#include <deque>
+#include <functional>
+#include <vector>
+#include <mutex>
+
+// An asynchronous counting semaphore. Callers ask for a slot with `acquire()` and are
+// started in FIFO order the moment one is handed back with `release()`.
+class ConnectionLimiter {
+public:
+    ConnectionLimiter(const boost::asio::any_io_executor& executor, int capacity)
+        : executor(executor),
+        capacity(capacity),
+        active(0)
+    {
+    }
+
+    // Runs `onAcquired` once a slot is available; it must call `release()` when done with it.
+    void acquire(std::function<void()> onAcquired);
+    // Returns a slot, handing it straight to the oldest waiter if there is one.
+    void release();
+    // Changes the amount of slots; extra waiters are started right away when it grows.
+    void setCapacity(int newCapacity);
+    // The amount of slots currently held.
+    int inFlight();
+
+private:
+    // Where handed over slots are started.
+    boost::asio::any_io_executor executor;
+    std::mutex limiterMutex;
+    int capacity;
+    int active;
+    std::deque<std::function<void()>> waiters;
+};
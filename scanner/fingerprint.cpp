@@ -1,97 +1,206 @@
 #include "fingerprint.h"
 
-#include <unordered_map>
-#include <string>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
-std::string getServiceNameForPort(int port) {
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+    struct ServiceEntry {
+        std::uint16_t port;
+        std::string_view name;
+    };
+
+    constexpr ServiceEntry BUILTIN_SERVICES[] = {
+        {     1, "tcpmux" },
+        {     7, "Echo" },
+        {     9, "Discard" },
+        {    13, "Daytime" },
+        {    17, "Quote of the Day" },
+        {    19, "CHARGEN" },
+        {    20, "FTP Data" },
+        {    21, "FTP Control" },
+        {    22, "SSH" },
+        {    23, "Telnet" },
+        {    25, "SMTP" },
+        {    37, "Time" },
+        {    42, "Nameserver" },
+        {    43, "WHOIS" },
+        {    49, "TACACS" },
+        {    53, "DNS" },
+        {    67, "DHCP Server" },
+        {    68, "DHCP Client" },
+        {    69, "TFTP" },
+        {    70, "Gopher" },
+        {    79, "Finger" },
+        {    80, "HTTP" },
+        {    88, "Kerberos" },
+        {   110, "POP3" },
+        {   111, "RPCbind" },
+        {   113, "Ident" },
+        {   119, "NNTP" },
+        {   123, "NTP" },
+        {   135, "MS RPC" },
+        {   137, "NetBIOS Name Service" },
+        {   138, "NetBIOS Datagram" },
+        {   139, "NetBIOS Session" },
+        {   143, "IMAP" },
+        {   161, "SNMP" },
+        {   162, "SNMP Trap" },
+        {   179, "BGP" },
+        {   389, "LDAP" },
+        {   443, "HTTPS" },
+        {   445, "SMB" },
+        {   465, "SMTPS" },
+        {   587, "SMTP (Submission)" },
+        {   631, "IPP" },
+        {   636, "LDAPS" },
+        {   993, "IMAP (SSL)" },
+        {   995, "POP3 (SSL)" },
+        {  1025, "NFS / IIS" },
+        {  1080, "SOCKS Proxy" },
+        {  1194, "OpenVPN" },
+        {  1433, "MSSQL" },
+        {  1521, "Oracle DB" },
+        {  1723, "PPTP" },
+        {  1900, "SSDP" },
+        {  2049, "NFS" },
+        {  2121, "FTP Alternative" },
+        {  3128, "Squid Proxy" },
+        {  3306, "MySQL" },
+        {  3389, "RDP" },
+        {  4000, "ICQ" },
+        {  4443, "Alternate HTTPS" },
+        {  4500, "IPsec NAT-Traversal" },
+        {  5000, "UPnP" },
+        {  5001, "UPnP" },
+        {  5432, "PostgreSQL" },
+        {  5353, "mDNS" },
+        {  5500, "VNC Alt" },
+        {  5800, "VNC over HTTP" },
+        {  5900, "VNC" },
+        {  6000, "X11" },
+        {  8000, "HTTP Alt" },
+        {  8080, "HTTP-Alt" },
+        {  8443, "HTTPS Alt" },
+        {  8888, "Alternate HTTP" },
+        {  9000, "HTTP Alt" },
+        {  9090, "Web Management" },
+        { 10000, "Webmin" },
+        { 11211, "Memcached" },
+        { 27017, "MongoDB" },
+        { 32400, "Plex" },
+        { 28017, "MongoDB HTTP" }
+    };
+
+    constexpr std::size_t BUILTIN_COUNT = sizeof(BUILTIN_SERVICES) / sizeof(BUILTIN_SERVICES[0]);
+    static_assert(BUILTIN_COUNT < 255, "the built in service index is a single byte");
+
+    // One byte per port pointing into BUILTIN_SERVICES, where BUILTIN_COUNT means "Unknown".
+    // Built by the compiler, so it costs 64 KiB of read only data and no start up time.
+    constexpr std::array<std::uint8_t, 65536> buildServiceIndex() {
+        std::array<std::uint8_t, 65536> index{};
+        for (std::uint8_t& entry : index) {
+            entry = static_cast<std::uint8_t>(BUILTIN_COUNT);
+        }
+        for (std::size_t i = 0; i < BUILTIN_COUNT; ++i) {
+            index[BUILTIN_SERVICES[i].port] = static_cast<std::uint8_t>(i);
+        }
+        return index;
+    }
+
+    constexpr std::array<std::uint8_t, 65536> BUILTIN_INDEX = buildServiceIndex();
+
+    // The services file stays mapped for the rest of the run; `loadedNames` points into it.
+    std::unique_ptr<boost::interprocess::mapped_region> servicesRegion;
+    std::vector<std::string_view> loadedNames;
+
+    std::string_view builtinServiceName(std::size_t port) {
+        std::uint8_t index = BUILTIN_INDEX[port];
+        return index < BUILTIN_COUNT ? BUILTIN_SERVICES[index].name : "Unknown";
+    }
+}
+
+std::string_view getServiceNameForPort(int port) {
     /*
     * @brief Fetches the associated service name for the provided port
-    * 
+    *
+    * A single lookup in a dense per port table, without hashing or copying. The names come
+    * from the services file when one was loaded, and from the built in list otherwise.
+    *
     * @param[in] the port value to check
     * @return the pretty name of the service that is typically associated for that port
     */
-    auto it = portToService.find(port);
-    return (it != portToService.end()) ? it->second : "Unknown";
+    if (port < 0 || port > 65535) {
+        return "Unknown";
+    }
+    if (!loadedNames.empty()) {
+        return loadedNames[port];
+    }
+    return builtinServiceName(static_cast<std::size_t>(port));
 }
 
-std::unordered_map<int, std::string> portToService {
-    {   1, "tcpmux" },
-    {   7, "Echo" },
-    {   9, "Discard" },
-    {  13, "Daytime" },
-    {  17, "Quote of the Day" },
-    {  19, "CHARGEN" },
-    {  20, "FTP Data" },
-    {  21, "FTP Control" },
-    {  22, "SSH" },
-    {  23, "Telnet" },
-    {  25, "SMTP" },
-    {  37, "Time" },
-    {  42, "Nameserver" },
-    {  43, "WHOIS" },
-    {  49, "TACACS" },
-    {  53, "DNS" },
-    {  67, "DHCP Server" },
-    {  68, "DHCP Client" },
-    {  69, "TFTP" },
-    {  70, "Gopher" },
-    {  79, "Finger" },
-    {  80, "HTTP" },
-    {  88, "Kerberos" },
-    { 110, "POP3" },
-    { 111, "RPCbind" },
-    { 113, "Ident" },
-    { 119, "NNTP" },
-    { 123, "NTP" },
-    { 135, "MS RPC" },
-    { 137, "NetBIOS Name Service" },
-    { 138, "NetBIOS Datagram" },
-    { 139, "NetBIOS Session" },
-    { 143, "IMAP" },
-    { 161, "SNMP" },
-    { 162, "SNMP Trap" },
-    { 179, "BGP" },
-    { 389, "LDAP" },
-    { 443, "HTTPS" },
-    { 445, "SMB" },
-    { 465, "SMTPS" },
-    { 587, "SMTP (Submission)" },
-    { 631, "IPP" },
-    { 636, "LDAPS" },
-    { 993, "IMAP (SSL)" },
-    { 995, "POP3 (SSL)" },
-    {1025, "NFS / IIS" },
-    {1080, "SOCKS Proxy" },
-    {1194, "OpenVPN" },
-    {1433, "MSSQL" },
-    {1521, "Oracle DB" },
-    {1723, "PPTP" },
-    {1900, "SSDP" },
-    {2049, "NFS" },
-    {2121, "FTP Alternative" },
-    {3128, "Squid Proxy" },
-    {3306, "MySQL" },
-    {3389, "RDP" },
-    {4000, "ICQ" },
-    {4443, "Alternate HTTPS" },
-    {4500, "IPsec NAT-Traversal" },
-    {5000, "UPnP" },
-    {5001, "UPnP" },
-    {5432, "PostgreSQL" },
-    {5353, "mDNS" },
-    {5500, "VNC Alt" },
-    {5800, "VNC over HTTP" },
-    {5900, "VNC" },
-    {6000, "X11" },
-    {8000, "HTTP Alt" },
-    {8080, "HTTP-Alt" },
-    {8443, "HTTPS Alt" },
-    {8888, "Alternate HTTP" },
-    {9000, "HTTP Alt" },
-    {9090, "Web Management" },
-    {10000, "Webmin" },
-    {11211, "Memcached" },
-    {27017, "MongoDB" },
-    {32400, "Plex"},
-    {28017, "MongoDB HTTP" }
-};
\ No newline at end of file
+bool loadServicesFile(const std::string& path) {
+    /*
+    * @brief Loads the TCP entries of an nmap-services style file
+    *
+    * Every line holds a name, a port/protocol pair and optional extra columns, separated by
+    * whitespace; # starts a comment. The file is mapped into memory and the names are used
+    * in place. Ports the file doesn't name keep their built in name. Must be called before
+    * the scan starts.
+    *
+    * @param[in] path The services file
+    * @return false if the file can't be mapped
+    */
+    std::unique_ptr<boost::interprocess::mapped_region> region;
+    try {
+        boost::interprocess::file_mapping file(path.c_str(), boost::interprocess::read_only);
+        region = std::make_unique<boost::interprocess::mapped_region>(file, boost::interprocess::read_only);
+    }
+    catch (const boost::interprocess::interprocess_exception&) {
+        return false;
+    }
+
+    std::vector<std::string_view> names(65536);
+    for (std::size_t port = 0; port < names.size(); ++port) {
+        names[port] = builtinServiceName(port);
+    }
+    std::string_view text(static_cast<const char*>(region->get_address()), region->get_size());
+    auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+    while (!text.empty()) {
+        std::size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+        line = line.substr(0, line.find('#'));
+
+        std::size_t nameEnd = 0;
+        while (nameEnd < line.size() && !isSpace(line[nameEnd])) {
+            nameEnd++;
+        }
+        std::size_t portStart = nameEnd;
+        while (portStart < line.size() && isSpace(line[portStart])) {
+            portStart++;
+        }
+        std::size_t slash = line.find('/', portStart);
+        if (nameEnd == 0 || slash == std::string_view::npos || line.substr(slash + 1, 3) != "tcp") {
+            continue;
+        }
+        std::string_view name = line.substr(0, nameEnd);
+        std::string_view digits = line.substr(portStart, slash - portStart);
+        int port = 0;
+        bool valid = !digits.empty() && digits.size() <= 5;
+        for (char c : digits) {
+            valid = valid && c >= '0' && c <= '9';
+            port = port * 10 + (c - '0');
+        }
+        if (valid && port <= 65535 && name != "unknown") {
+            names[port] = name;
+        }
+    }
+    servicesRegion = std::move(region);
+    loadedNames = std::move(names);
+    return true;
+}
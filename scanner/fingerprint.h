@@ -1,6 +1,9 @@
-#include <unordered_map>
-#include <iostream>
-extern std::unordered_map<int, std::string> portToService;
+#pragma once
+#include <string>
+#include <string_view>
 
 // Fetches the assiocated service for the passed port
-std::string getServiceNameForPort(int port);
\ No newline at end of file
+std::string_view getServiceNameForPort(int port);
+
+// Replaces the built in service names with the TCP entries of an nmap-services style file
+bool loadServicesFile(const std::string& path);
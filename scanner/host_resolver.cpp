@@ -0,0 +1,237 @@
+#include "host_resolver.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+HostResolver::HostResolver(TargetSpace& targets, int lanes, std::shared_ptr<spdlog::logger> logger)
+    : targets(targets),
+    logger(std::move(logger)),
+    cursor(0)
+{
+    /**
+     * @brief Creates the lanes; nothing is resolved until `start()`.
+     *
+     * @param targets The space holding the pending hosts.
+     * @param lanes The largest amount of lookups in flight at once.
+     * @param logger Where failed lookups are reported.
+     */
+    for (int i = 0; i < std::max(1, lanes); ++i) {
+        this->lanes.push_back(std::make_unique<Lane>());
+    }
+}
+
+HostResolver::~HostResolver() {
+    join();
+}
+
+bool HostResolver::loadHostsFile(const std::string& path) {
+    /**
+     * @brief Reads a hosts file into the cache.
+     *
+     * Uses the /etc/hosts layout: an address followed by one or more names, with '#' starting a
+     * comment. Only IPv4 addresses are kept, the same as for looked up names.
+     *
+     * @param path The file to read.
+     * @return false if the file could not be opened.
+     */
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string addressText;
+        if (!(fields >> addressText)) {
+            continue;
+        }
+        boost::system::error_code ec;
+        boost::asio::ip::address address = boost::asio::ip::make_address(addressText, ec);
+        if (ec || !address.is_v4()) {
+            continue;
+        }
+        std::string name;
+        while (fields >> name) {
+            cache.emplace(name, address);
+        }
+    }
+    return true;
+}
+
+void HostResolver::start() {
+    /**
+     * @brief Groups the pending hosts by name and starts one lookup per lane.
+     *
+     * Names found in the cache are published right away. Each lane pulls the next name as soon
+     * as its previous lookup completes, so slow names only hold up their own lane.
+     */
+    for (std::size_t hostIndex = 0; hostIndex < targets.hostCount(); ++hostIndex) {
+        if (targets.hostState(hostIndex) != TargetSpace::HostState::Pending) {
+            continue;
+        }
+        const std::string& name = targets.hostName(hostIndex);
+        std::vector<std::size_t>& hosts = hostsByName[name];
+        if (hosts.empty()) {
+            names.push_back(name);
+        }
+        hosts.push_back(hostIndex);
+    }
+    names.erase(std::remove_if(names.begin(), names.end(), [this](const std::string& name) {
+        auto cached = cache.find(name);
+        if (cached == cache.end()) {
+            return false;
+        }
+        finish(name, &cached->second);
+        return true;
+        }), names.end());
+    if (names.empty()) {
+        // Nothing to look up, so no lane threads are started.
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(waitersMutex);
+        unfinished = names.size();
+    }
+
+    for (std::unique_ptr<Lane>& lane : lanes) {
+        Lane* current = lane.get();
+        boost::asio::post(current->ctx, [this, current]() {
+            resolveNext(*current);
+            });
+        threads.emplace_back([current]() { current->ctx.run(); });
+    }
+}
+
+void HostResolver::resolveNext(Lane& lane) {
+    /**
+     * @brief Looks up the next name nobody has claimed yet.
+     *
+     * The first IPv4 address in the answer is used. The lane's io_context runs out of work, and
+     * its thread exits, once every name has been claimed.
+     *
+     * @param lane The lane to run the lookup on.
+     */
+    std::size_t index = cursor.fetch_add(1, std::memory_order_relaxed);
+    if (index >= names.size()) {
+        return;
+    }
+    const std::string& name = names[index];
+    lane.resolver.async_resolve(name, "",
+        [this, &lane, &name](const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::results_type endpoints) {
+            if (ec) {
+                logger->error("Failed to resolve domain '{}' ({})", name, ec.message());
+                finish(name, nullptr);
+                resolveNext(lane);
+                return;
+            }
+            for (const auto& entry : endpoints) {
+                boost::asio::ip::address address = entry.endpoint().address();
+                if (address.is_v4()) {
+                    finish(name, &address);
+                    resolveNext(lane);
+                    return;
+                }
+                logger->info("Domain '{}' resolved to an IPv6 address '{}', but IPv6 support is currently disabled. Ignoring this address.", name, address.to_string());
+            }
+            finish(name, nullptr);
+            resolveNext(lane);
+        });
+}
+
+void HostResolver::finish(const std::string& name, const boost::asio::ip::address* address) {
+    /**
+     * @brief Publishes the outcome of a name and posts the probes that were waiting on it.
+     *
+     * The state is published while holding `waitersMutex`, so a probe either sees the new state
+     * in `whenResolved()` or is already queued here.
+     *
+     * @param name The name that finished.
+     * @param address The address it resolved to, or nullptr if it failed.
+     */
+    std::vector<Waiter> ready;
+    {
+        std::lock_guard<std::mutex> lock(waitersMutex);
+        for (std::size_t hostIndex : hostsByName.at(name)) {
+            if (address) {
+                targets.resolveHost(hostIndex, *address);
+            }
+            else {
+                targets.failHost(hostIndex);
+            }
+            auto waiting = waiters.find(hostIndex);
+            if (waiting != waiters.end()) {
+                std::move(waiting->second.begin(), waiting->second.end(), std::back_inserter(ready));
+                waiters.erase(waiting);
+            }
+        }
+        // Cached names are published before `unfinished` is counted.
+        if (unfinished > 0 && --unfinished == 0) {
+            std::move(finishedWaiters.begin(), finishedWaiters.end(), std::back_inserter(ready));
+            finishedWaiters.clear();
+        }
+    }
+    for (Waiter& waiter : ready) {
+        boost::asio::post(waiter.executor, std::move(waiter.onDone));
+    }
+}
+
+void HostResolver::whenResolved(std::size_t targetIndex, const boost::asio::any_io_executor& executor, std::function<void()> onDone) {
+    /**
+     * @brief Runs `onDone` on `executor` once the target's name has an outcome.
+     *
+     * The waiter keeps outstanding work on `executor`, so the scan's io_context doesn't run dry
+     * while every probe it holds is waiting on a lookup.
+     *
+     * @param targetIndex A target whose state was Pending.
+     * @param executor Where to run `onDone`.
+     * @param onDone Checks the target's state again and carries on with the probe.
+     */
+    std::int64_t hostIndex = targets.hostIndexAt(targetIndex);
+    {
+        std::lock_guard<std::mutex> lock(waitersMutex);
+        if (targets.stateAt(targetIndex) == TargetSpace::HostState::Pending) {
+            waiters[static_cast<std::size_t>(hostIndex)].push_back({
+                boost::asio::prefer(executor, boost::asio::execution::outstanding_work.tracked),
+                std::move(onDone)
+                });
+            return;
+        }
+    }
+    boost::asio::post(executor, std::move(onDone));
+}
+
+void HostResolver::whenFinished(const boost::asio::any_io_executor& executor, std::function<void()> onDone) {
+    /**
+     * @brief Runs `onDone` on `executor` once no name is left to look up.
+     *
+     * Unlike `join()` this never blocks, so it can be used from a thread of an executor owned
+     * by someone else.
+     *
+     * @param executor Where to run `onDone`.
+     * @param onDone Called once every lookup has finished.
+     */
+    {
+        std::lock_guard<std::mutex> lock(waitersMutex);
+        if (unfinished > 0) {
+            finishedWaiters.push_back({
+                boost::asio::prefer(executor, boost::asio::execution::outstanding_work.tracked),
+                std::move(onDone)
+                });
+            return;
+        }
+    }
+    boost::asio::post(executor, std::move(onDone));
+}
+
+void HostResolver::join() {
+    /**
+     * @brief Waits for the lane threads to run out of names.
+     */
+    for (std::thread& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
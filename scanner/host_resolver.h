@@ -0,0 +1,77 @@
+#pragma once
+#include <boost/asio.hpp>
+
+#define FMT_UNICODE 0
+#include "spdlog/spdlog.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "config/target_space.h"
+
+// Resolves the pending domains of a TargetSpace in the background while the scan runs.
+// Lookups are spread over a fixed amount of lanes, each with its own io_context and
+// resolver, so at most that many names are in flight at once. Repeated names, and names
+// found in a hosts file, are only resolved once.
+class HostResolver {
+public:
+    HostResolver(TargetSpace& targets, int lanes, std::shared_ptr<spdlog::logger> logger);
+    ~HostResolver();
+
+    HostResolver(const HostResolver&) = delete;
+    HostResolver& operator=(const HostResolver&) = delete;
+
+    // Seeds the cache from a hosts file ("address name [aliases...]"); returns false if it can't be read.
+    bool loadHostsFile(const std::string& path);
+    // Starts resolving every pending host on the lane threads.
+    void start();
+    // Posts `onDone` to `executor` once the target at `targetIndex` has resolved or failed.
+    void whenResolved(std::size_t targetIndex, const boost::asio::any_io_executor& executor, std::function<void()> onDone);
+    // Posts `onDone` to `executor` once every lookup has finished, without blocking.
+    void whenFinished(const boost::asio::any_io_executor& executor, std::function<void()> onDone);
+    // Blocks until every lookup has finished.
+    void join();
+
+private:
+    struct Lane {
+        Lane()
+            : resolver(ctx)
+        {
+        }
+
+        boost::asio::io_context ctx;
+        boost::asio::ip::tcp::resolver resolver;
+    };
+
+    struct Waiter {
+        boost::asio::any_io_executor executor;
+        std::function<void()> onDone;
+    };
+
+    // Starts the lookup of the next unresolved name on `lane`.
+    void resolveNext(Lane& lane);
+    // Publishes the result of a name to every host using it and wakes their waiters.
+    void finish(const std::string& name, const boost::asio::ip::address* address);
+
+    TargetSpace& targets;
+    std::shared_ptr<spdlog::logger> logger;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    std::vector<std::thread> threads;
+    // Hosts file entries, consulted before anything is looked up.
+    std::unordered_map<std::string, boost::asio::ip::address> cache;
+    // The hosts using each name, and the names that still have to be looked up.
+    std::unordered_map<std::string, std::vector<std::size_t>> hostsByName;
+    std::vector<std::string> names;
+    std::atomic<std::size_t> cursor;
+    std::mutex waitersMutex;
+    std::unordered_map<std::size_t, std::vector<Waiter>> waiters;
+    // The names still being looked up, and who waits for them all.
+    std::size_t unfinished = 0;
+    std::vector<Waiter> finishedWaiters;
+};
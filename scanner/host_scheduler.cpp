@@ -0,0 +1,68 @@
+#include "host_scheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+
+HostScheduler::HostScheduler(int hostCap, std::size_t buckets)
+    : hostCap(std::max(1, hostCap)),
+    minCap(std::max(1, hostCap / MIN_CAP_DIVISOR)),
+    bucketCount(std::max<std::size_t>(1, buckets)),
+    hosts(new Host[bucketCount])
+{
+}
+
+HostScheduler::Host& HostScheduler::hostFor(std::size_t targetIndex) const {
+    return hosts[keyFor(targetIndex)];
+}
+
+std::size_t HostScheduler::keyFor(std::size_t targetIndex) const {
+    return targetIndex % bucketCount;
+}
+
+bool HostScheduler::tryAcquire(std::size_t targetIndex) {
+    /**
+     * @brief Claims one of the target's in-flight slots with a compare and swap.
+     *
+     * @param targetIndex The index in `targets` of the target about to be probed.
+     * @return false if the target already has its cap in flight.
+     */
+    Host& host = hostFor(targetIndex);
+    int cap = capFor(targetIndex);
+    int inFlight = host.inFlight.load(std::memory_order_relaxed);
+    do {
+        if (inFlight >= cap) {
+            return false;
+        }
+    } while (!host.inFlight.compare_exchange_weak(inFlight, inFlight + 1, std::memory_order_relaxed));
+    return true;
+}
+
+void HostScheduler::release(std::size_t targetIndex) {
+    hostFor(targetIndex).inFlight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void HostScheduler::onAnswer(std::size_t targetIndex) {
+    std::atomic<int>& score = hostFor(targetIndex).timeoutScore;
+    int current = score.load(std::memory_order_relaxed);
+    while (current > 0 && !score.compare_exchange_weak(current, current - (current + SCORE_WEIGHT - 1) / SCORE_WEIGHT, std::memory_order_relaxed)) {
+    }
+}
+
+void HostScheduler::onTimeout(std::size_t targetIndex) {
+    std::atomic<int>& score = hostFor(targetIndex).timeoutScore;
+    int current = score.load(std::memory_order_relaxed);
+    while (current < SCORE_SCALE && !score.compare_exchange_weak(current, current + (SCORE_SCALE - current + SCORE_WEIGHT - 1) / SCORE_WEIGHT, std::memory_order_relaxed)) {
+    }
+}
+
+int HostScheduler::capFor(std::size_t targetIndex) const {
+    /**
+     * @brief Scales `hostCap` by the share of the target's recent probes that got an answer.
+     *
+     * @param targetIndex The index in `targets` of the target.
+     * @return Between hostCap / MIN_CAP_DIVISOR (at least 1) and `hostCap`.
+     */
+    int score = hostFor(targetIndex).timeoutScore.load(std::memory_order_relaxed);
+    std::int64_t cap = static_cast<std::int64_t>(hostCap) * (SCORE_SCALE - score) / SCORE_SCALE;
+    return static_cast<int>(std::max<std::int64_t>(minCap, cap));
+}
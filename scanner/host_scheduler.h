@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Caps the probes each target has in flight, so a host that sits on timeouts can't take every
+// connection slot from the hosts that answer. A target may hold `hostCap` probes while it
+// answers; as its share of timeouts climbs the cap shrinks, down to an eighth of `hostCap`
+// (at least one), and answers win the slots back.
+//
+// Like the per target RateLimiter the table is exact for up to `buckets` targets and hashed by
+// target index beyond that, so targets sharing a bucket share its cap.
+class HostScheduler {
+public:
+    HostScheduler(int hostCap, std::size_t buckets);
+
+    // Takes an in-flight slot of the target if it is below its cap.
+    bool tryAcquire(std::size_t targetIndex);
+    // Gives back a slot taken by `tryAcquire()`.
+    void release(std::size_t targetIndex);
+    // Feeds an answered (open or refused) and an unanswered probe into the target's timeout share.
+    void onAnswer(std::size_t targetIndex);
+    void onTimeout(std::size_t targetIndex);
+    // The amount of probes the target may have in flight right now.
+    int capFor(std::size_t targetIndex) const;
+    // The bucket the target shares its cap with, the same for every target hashed to it.
+    std::size_t keyFor(std::size_t targetIndex) const;
+
+private:
+    // The timeout share is kept in 1/SCORE_SCALE steps, and every outcome moves it
+    // 1/SCORE_WEIGHT of the way towards all or none.
+    static constexpr int SCORE_SCALE = 1024;
+    static constexpr int SCORE_WEIGHT = 8;
+    // The cap never drops below hostCap / MIN_CAP_DIVISOR.
+    static constexpr int MIN_CAP_DIVISOR = 8;
+
+    struct Host {
+        std::atomic<int> inFlight{ 0 };
+        std::atomic<int> timeoutScore{ 0 };
+    };
+
+    Host& hostFor(std::size_t targetIndex) const;
+
+    int hostCap;
+    int minCap;
+    std::size_t bucketCount;
+    std::unique_ptr<Host[]> hosts;
+};
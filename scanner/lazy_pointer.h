@@ -0,0 +1,22 @@
+#pragma once
+#include <atomic>
+
+template <typename T>
+T& loadOrCreate(std::atomic<T*>& slot) {
+    /**
+     * @brief Fetches the object behind an atomic pointer, allocating it on first use.
+     *
+     * When two threads race to allocate the same object, the loser frees its copy and uses
+     * the one that won the compare and swap.
+     */
+    T* existing = slot.load(std::memory_order_acquire);
+    if (existing) {
+        return *existing;
+    }
+    T* created = new T();
+    if (slot.compare_exchange_strong(existing, created, std::memory_order_acq_rel)) {
+        return *created;
+    }
+    delete created;
+    return *existing;
+}
@@ -0,0 +1,38 @@
+#include "live_hosts.h"
+
+#include <bit>
+
+LiveHosts::LiveHosts(std::size_t targetCount)
+    : targetCount(targetCount),
+    words(new std::atomic<std::uint64_t>[(targetCount + 63) / 64])
+{
+    for (std::size_t i = 0; i < (targetCount + 63) / 64; ++i) {
+        words[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+bool LiveHosts::mark(std::size_t targetIndex) {
+    std::uint64_t bit = std::uint64_t(1) << (targetIndex % 64);
+    return !(words[targetIndex / 64].fetch_or(bit, std::memory_order_relaxed) & bit);
+}
+
+bool LiveHosts::contains(std::size_t targetIndex) const {
+    return words[targetIndex / 64].load(std::memory_order_relaxed) & (std::uint64_t(1) << (targetIndex % 64));
+}
+
+std::vector<std::size_t> LiveHosts::collect() const {
+    /**
+     * @brief Lists the alive targets; only complete once every discovery probe has finished.
+     *
+     * @return The indexes of the targets that answered, in ascending order.
+     */
+    std::vector<std::size_t> alive;
+    for (std::size_t i = 0; i < (targetCount + 63) / 64; ++i) {
+        std::uint64_t word = words[i].load(std::memory_order_relaxed);
+        while (word) {
+            alive.push_back(i * 64 + static_cast<std::size_t>(std::countr_zero(word)));
+            word &= word - 1;
+        }
+    }
+    return alive;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// The targets that answered a probe, one bit per target so even a /8 costs only two
+// megabytes. Marked lock-free from the probe paths of every shard.
+class LiveHosts {
+public:
+    explicit LiveHosts(std::size_t targetCount);
+
+    // Marks a target as alive; returns false if it already was.
+    bool mark(std::size_t targetIndex);
+    bool contains(std::size_t targetIndex) const;
+    // The alive targets in ascending order.
+    std::vector<std::size_t> collect() const;
+
+private:
+    std::size_t targetCount;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+};
@@ -0,0 +1,444 @@
+#include "output_sink.h"
+
+#include <charconv>
+#include <chrono>
+#include <string>
+#include <vector>
+
+void appendJsonString(std::string& out, std::string_view value) {
+    /**
+     * @brief Appends `value` as a quoted JSON string.
+     */
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[7];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            }
+            else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+namespace {
+    // Flush as soon as this much output is waiting, without waiting for the interval.
+    constexpr std::size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    const char* stateName(PortState state) {
+        switch (state) {
+        case PortState::Open:     return "open";
+        case PortState::Closed:   return "closed";
+        case PortState::Filtered: return "filtered";
+        default:                  return "unknown";
+        }
+    }
+
+    bool parseState(std::string_view name, PortState& state) {
+        for (PortState candidate : { PortState::Open, PortState::Closed, PortState::Filtered, PortState::Unknown }) {
+            if (name == stateName(candidate)) {
+                state = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parsePort(std::string_view text, int& port) {
+        // from_chars reports bad input instead of throwing, so a corrupt line is just skipped.
+        auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), port);
+        return !text.empty() && ec == std::errc() && end == text.data() + text.size() && port >= 0 && port <= 65535;
+    }
+
+    bool parseAddress(std::string_view text, boost::asio::ip::address& address) {
+        boost::system::error_code ec;
+        address = boost::asio::ip::make_address(std::string(text), ec);
+        return !ec;
+    }
+
+    bool readJsonString(std::string_view line, std::size_t& position, std::string& value) {
+        /**
+         * @brief Reads the quoted string starting at `position`, undoing what appendJsonString escapes.
+         */
+        if (position >= line.size() || line[position] != '"') {
+            return false;
+        }
+        value.clear();
+        for (++position; position < line.size(); ++position) {
+            char c = line[position];
+            if (c == '"') {
+                ++position;
+                return true;
+            }
+            if (c != '\\') {
+                value += c;
+                continue;
+            }
+            if (++position == line.size()) {
+                return false;
+            }
+            switch (line[position]) {
+            case 'n': value += '\n'; break;
+            case 'r': value += '\r'; break;
+            case 't': value += '\t'; break;
+            case 'u': {
+                if (position + 4 >= line.size()) {
+                    return false;
+                }
+                unsigned int code = 0;
+                const char* digits = line.data() + position + 1;
+                auto [end, ec] = std::from_chars(digits, digits + 4, code, 16);
+                if (ec != std::errc() || end != digits + 4) {
+                    return false;
+                }
+                value += static_cast<char>(code);
+                position += 4;
+                break;
+            }
+            default:  value += line[position];
+            }
+        }
+        return false;
+    }
+
+    bool findJsonField(std::string_view line, std::string_view key, std::size_t& position) {
+        /**
+         * @brief Moves `position` to the value of `key` in a flat JSON object.
+         */
+        std::string pattern = "\"" + std::string(key) + "\":";
+        position = line.find(pattern);
+        if (position == std::string_view::npos) {
+            return false;
+        }
+        position += pattern.size();
+        return true;
+    }
+
+    std::vector<std::string> splitCsv(std::string_view line) {
+        /**
+         * @brief Splits a CSV line into its fields, unquoting the quoted ones.
+         */
+        std::vector<std::string> fields(1);
+        bool quoted = false;
+        for (std::size_t i = 0; i < line.size(); ++i) {
+            char c = line[i];
+            if (quoted) {
+                if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                    fields.back() += '"';
+                    ++i;
+                }
+                else if (c == '"') {
+                    quoted = false;
+                }
+                else {
+                    fields.back() += c;
+                }
+            }
+            else if (c == '"') {
+                quoted = true;
+            }
+            else if (c == ',') {
+                fields.emplace_back();
+            }
+            else {
+                fields.back() += c;
+            }
+        }
+        return fields;
+    }
+
+    void appendCsvField(std::string& out, std::string_view value) {
+        /**
+         * @brief Appends `value` as a CSV field, quoting it when it contains a separator or quote.
+         */
+        if (value.find_first_of(",\"\r\n") == std::string_view::npos) {
+            out += value;
+            return;
+        }
+        out += '"';
+        for (char c : value) {
+            if (c == '"') {
+                out += '"';
+            }
+            out += c;
+        }
+        out += '"';
+    }
+
+    // {"host":"example.com","address":"93.184.216.34","port":443,"protocol":"tcp","state":"open","service":"HTTPS"}
+    class JsonLinesFormat : public OutputFormat {
+    public:
+        void append(std::string& out, const Target& target, PortInfo portInfo, std::string_view service) const override {
+            out += "{\"host\":";
+            appendJsonString(out, target.hostname.empty() ? target.address.to_string() : target.hostname);
+            out += ",\"address\":";
+            appendJsonString(out, target.address.to_string());
+            out += ",\"port\":";
+            out += std::to_string(portInfo.port);
+            out += ",\"protocol\":\"tcp\",\"state\":\"";
+            out += stateName(portInfo.status);
+            out += "\",\"service\":";
+            appendJsonString(out, service);
+            out += "}\n";
+        }
+
+        bool parse(std::string_view line, ResultRecord& record) const override {
+            std::size_t position;
+            std::string host;
+            std::string address;
+            std::string state;
+            if (!findJsonField(line, "host", position) || !readJsonString(line, position, host)
+                || !findJsonField(line, "address", position) || !readJsonString(line, position, address)
+                || !findJsonField(line, "state", position) || !readJsonString(line, position, state)
+                || !findJsonField(line, "service", position) || !readJsonString(line, position, record.service)
+                || !findJsonField(line, "port", position)) {
+                return false;
+            }
+            std::size_t end = line.find_first_not_of("0123456789", position);
+            record.hostname = host == address ? "" : host;
+            return parseAddress(address, record.address)
+                && parsePort(line.substr(position, end - position), record.portInfo.port)
+                && parseState(state, record.portInfo.status);
+        }
+    };
+
+    // host,address,port,protocol,state,service
+    // The host column repeats the address for targets given as one, like JSON Lines.
+    class CsvFormat : public OutputFormat {
+    public:
+        std::string header() const override {
+            return "host,address,port,protocol,state,service\n";
+        }
+
+        void append(std::string& out, const Target& target, PortInfo portInfo, std::string_view service) const override {
+            appendCsvField(out, target.hostname.empty() ? target.address.to_string() : target.hostname);
+            out += ',';
+            out += target.address.to_string();
+            out += ',';
+            out += std::to_string(portInfo.port);
+            out += ",tcp,";
+            out += stateName(portInfo.status);
+            out += ',';
+            appendCsvField(out, service);
+            out += '\n';
+        }
+
+        bool parse(std::string_view line, ResultRecord& record) const override {
+            std::vector<std::string> fields = splitCsv(line);
+            if (fields.size() != 6 || fields[3] != "tcp") {
+                return false;
+            }
+            record.hostname = fields[0] == fields[1] ? "" : fields[0];
+            record.service = fields[5];
+            return parseAddress(fields[1], record.address)
+                && parsePort(fields[2], record.portInfo.port)
+                && parseState(fields[4], record.portInfo.status);
+        }
+    };
+
+    // Host: 93.184.216.34 (example.com)	Ports: 443/open/tcp//HTTPS///
+    class GrepableFormat : public OutputFormat {
+    public:
+        void append(std::string& out, const Target& target, PortInfo portInfo, std::string_view service) const override {
+            out += "Host: ";
+            out += target.address.to_string();
+            out += " (";
+            out += target.hostname;
+            out += ")\tPorts: ";
+            out += std::to_string(portInfo.port);
+            out += '/';
+            out += stateName(portInfo.status);
+            out += "/tcp//";
+            // '/' separates the fields, so it is written as '|' like nmap does.
+            for (char c : service) {
+                out += c == '/' ? '|' : c;
+            }
+            out += "///\n";
+        }
+
+        bool parse(std::string_view line, ResultRecord& record) const override {
+            constexpr std::string_view HOST = "Host: ";
+            constexpr std::string_view PORTS = ")\tPorts: ";
+            std::size_t open = line.find(" (");
+            std::size_t ports = line.find(PORTS);
+            if (line.substr(0, HOST.size()) != HOST || open == std::string_view::npos || ports == std::string_view::npos || ports < open) {
+                return false;
+            }
+            std::vector<std::string_view> fields;
+            std::string_view entry = line.substr(ports + PORTS.size());
+            for (std::size_t slash; (slash = entry.find('/')) != std::string_view::npos; entry.remove_prefix(slash + 1)) {
+                fields.push_back(entry.substr(0, slash));
+            }
+            if (fields.size() < 5 || fields[2] != "tcp") {
+                return false;
+            }
+            record.hostname = std::string(line.substr(open + 2, ports - open - 2));
+            record.service = std::string(fields[4]);
+            return parseAddress(line.substr(HOST.size(), open - HOST.size()), record.address)
+                && parsePort(fields[0], record.portInfo.port)
+                && parseState(fields[1], record.portInfo.status);
+        }
+    };
+}
+
+std::unique_ptr<OutputFormat> OutputFormat::create(const std::string& name) {
+    /**
+     * @brief Looks up an output format by the name used with `--output-format`.
+     *
+     * @param name "jsonl", "csv" or "grep".
+     * @return The format, or nullptr if the name is unknown.
+     */
+    if (name == "jsonl") {
+        return std::make_unique<JsonLinesFormat>();
+    }
+    if (name == "csv") {
+        return std::make_unique<CsvFormat>();
+    }
+    if (name == "grep") {
+        return std::make_unique<GrepableFormat>();
+    }
+    return nullptr;
+}
+
+std::unique_ptr<OutputFormat> OutputFormat::detect(std::string_view firstLine) {
+    /**
+     * @brief Picks the format that wrote a results file.
+     *
+     * @param firstLine The first line of the file.
+     * @return The format, or nullptr if the line looks like none of them.
+     */
+    if (firstLine.substr(0, 1) == "{") {
+        return create("jsonl");
+    }
+    if (firstLine.substr(0, 5) == "host,") {
+        return create("csv");
+    }
+    if (firstLine.substr(0, 6) == "Host: ") {
+        return create("grep");
+    }
+    return nullptr;
+}
+
+std::string OutputFormat::header() const {
+    return "";
+}
+
+OutputSink::OutputSink(std::unique_ptr<OutputFormat> format, std::FILE* stream, bool ownsStream)
+    : format(std::move(format)),
+    stream(stream),
+    ownsStream(ownsStream),
+    closing(false)
+{
+    /**
+     * @brief Writes the format's header and starts the writer thread.
+     *
+     * @param format How each port is written.
+     * @param stream Where the output goes.
+     * @param ownsStream Close `stream` once the sink is closed.
+     */
+    buffer = this->format->header();
+    writer = std::thread([this]() { run(); });
+}
+
+OutputSink::~OutputSink() {
+    close();
+}
+
+std::unique_ptr<OutputSink> OutputSink::open(const std::string& path, const std::string& formatName) {
+    /**
+     * @brief Opens an output file for streaming results.
+     *
+     * @param path The file to create, or "-" for stdout.
+     * @param formatName The name of the output format.
+     * @return The sink, or nullptr if the format is unknown or the file can't be created.
+     */
+    std::unique_ptr<OutputFormat> format = OutputFormat::create(formatName);
+    if (!format) {
+        return nullptr;
+    }
+    if (path == "-") {
+        return std::make_unique<OutputSink>(std::move(format), stdout, false);
+    }
+    std::FILE* stream = std::fopen(path.c_str(), "w");
+    if (!stream) {
+        return nullptr;
+    }
+    return std::make_unique<OutputSink>(std::move(format), stream, true);
+}
+
+void OutputSink::write(const Target& target, PortInfo portInfo, std::string_view service) {
+    /**
+     * @brief Formats a port on the calling thread and queues it for the writer thread.
+     *
+     * @param target The target the port was found on.
+     * @param portInfo The port and its state.
+     * @param service The service identified on the port, or its usual service.
+     */
+    std::string line;
+    format->append(line, target, portInfo, service);
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        buffer += line;
+        full = buffer.size() >= FLUSH_THRESHOLD;
+    }
+    if (full) {
+        bufferReady.notify_one();
+    }
+}
+
+void OutputSink::run() {
+    /**
+     * @brief Swaps the queued output out and writes it without holding the lock.
+     *
+     * Results reach the output within 100 ms even when they trickle in slowly, so a pipe
+     * reading the output sees them while the scan is still running.
+     */
+    std::string pending;
+    std::unique_lock<std::mutex> lock(bufferMutex);
+    while (true) {
+        bufferReady.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+            return closing || buffer.size() >= FLUSH_THRESHOLD;
+            });
+        pending.swap(buffer);
+        bool done = closing;
+        lock.unlock();
+        if (!pending.empty()) {
+            std::fwrite(pending.data(), 1, pending.size(), stream);
+            std::fflush(stream);
+            pending.clear();
+        }
+        if (done) {
+            return;
+        }
+        lock.lock();
+    }
+}
+
+void OutputSink::close() {
+    /**
+     * @brief Writes out whatever is still queued and waits for the writer thread.
+     */
+    {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        if (closing) {
+            return;
+        }
+        closing = true;
+    }
+    bufferReady.notify_one();
+    writer.join();
+    if (ownsStream) {
+        std::fclose(stream);
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "config/target.h"
+#include "result_store.h"
+
+// Appends `value` to `out` as a quoted and escaped JSON string.
+void appendJsonString(std::string& out, std::string_view value);
+
+// One port read back from a results file.
+struct ResultRecord {
+    // The domain the target was given as, empty for plain addresses.
+    std::string hostname;
+    boost::asio::ip::address address;
+    PortInfo portInfo;
+    std::string service;
+};
+
+// Turns a discovered port into one line of a machine readable format, and reads such lines back.
+class OutputFormat {
+public:
+    virtual ~OutputFormat() = default;
+
+    // Creates the format called `name` ("jsonl", "csv" or "grep"), or nullptr if there is none.
+    static std::unique_ptr<OutputFormat> create(const std::string& name);
+    // Recognises the format a results file was written in from its first line, or nullptr.
+    static std::unique_ptr<OutputFormat> detect(std::string_view firstLine);
+
+    // Text written once before the first result.
+    virtual std::string header() const;
+    // Appends the line for one port of `target`, running `service`, to `out`.
+    virtual void append(std::string& out, const Target& target, PortInfo portInfo, std::string_view service) const = 0;
+    // Reads a line written by `append()` into `record`; returns false for anything else.
+    virtual bool parse(std::string_view line, ResultRecord& record) const = 0;
+};
+
+// Streams results to a file (or stdout for "-") as they are discovered. Reactor threads only
+// format the line and append it to a buffer; a writer thread flushes the buffer in batches so
+// the scan never waits on the disk or a slow pipe.
+class OutputSink {
+public:
+    OutputSink(std::unique_ptr<OutputFormat> format, std::FILE* stream, bool ownsStream);
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    // Opens `path` for writing in `formatName`; returns nullptr if either is invalid.
+    static std::unique_ptr<OutputSink> open(const std::string& path, const std::string& formatName);
+
+    // Queues one discovered port and its service. Safe to call from any thread.
+    void write(const Target& target, PortInfo portInfo, std::string_view service);
+    // Flushes everything queued and stops the writer thread.
+    void close();
+
+private:
+    // Writes the buffer out whenever it fills up, or at least every 100 ms.
+    void run();
+
+    std::unique_ptr<OutputFormat> format;
+    std::FILE* stream;
+    bool ownsStream;
+    std::mutex bufferMutex;
+    std::condition_variable bufferReady;
+    std::string buffer;
+    bool closing;
+    std::thread writer;
+};
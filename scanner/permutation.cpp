@@ -0,0 +1,54 @@
+#include "permutation.h"
+
+namespace {
+    std::uint64_t mix(std::uint64_t value) {
+        /**
+         * @brief The splitmix64 finalizer: every input bit affects every output bit.
+         */
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+}
+
+Permutation::Permutation(std::uint64_t size, std::uint64_t seed)
+    : size(size),
+    halfBits(1)
+{
+    while (halfBits < 32 && (std::uint64_t(1) << (2 * halfBits)) < size) {
+        halfBits++;
+    }
+    halfMask = (std::uint64_t(1) << halfBits) - 1;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        seed += 0x9e3779b97f4a7c15ULL;
+        keys[i] = mix(seed);
+    }
+}
+
+std::uint64_t Permutation::encrypt(std::uint64_t value) const {
+    std::uint64_t left = value >> halfBits;
+    std::uint64_t right = value & halfMask;
+    for (std::uint64_t key : keys) {
+        std::uint64_t next = left ^ (mix(right ^ key) & halfMask);
+        left = right;
+        right = next;
+    }
+    return (left << halfBits) | right;
+}
+
+std::uint64_t Permutation::at(std::uint64_t index) const {
+    /**
+     * @brief Maps an index to its shuffled position.
+     *
+     * Walking the cycle of `index` through the network always returns to the range, since the
+     * cycle contains `index` itself, and no two indexes in the range can land on the same value.
+     *
+     * @param index A value below `size`.
+     * @return The shuffled position, also below `size`.
+     */
+    std::uint64_t value = index;
+    do {
+        value = encrypt(value);
+    } while (value >= size);
+    return value;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// A keyed pseudo random permutation of [0, size) that needs no memory beyond its keys, so
+// the probe order of a scan of any size can be shuffled and reproduced from a seed. It is a
+// four round Feistel network over the smallest power of four covering `size`; results that
+// fall outside the range are encrypted again (cycle walking), which takes under four rounds
+// on average because that power of four is less than four times `size`.
+class Permutation {
+public:
+    Permutation(std::uint64_t size, std::uint64_t seed);
+
+    // The position `index` (below `size`) is moved to.
+    std::uint64_t at(std::uint64_t index) const;
+
+private:
+    // One pass of the Feistel network over the power of four.
+    std::uint64_t encrypt(std::uint64_t value) const;
+
+    std::uint64_t size;
+    // Bits in each half of the Feistel block.
+    unsigned int halfBits;
+    std::uint64_t halfMask;
+    std::array<std::uint64_t, 4> keys;
+};
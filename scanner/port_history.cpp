@@ -0,0 +1,175 @@
+#include "port_history.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+
+namespace {
+    constexpr char MAGIC[8] = { 'B', 'P', 'S', 'S', 'T', 'A', 'T', '1' };
+
+    template <typename T>
+    void writeValue(std::ofstream& file, T value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    bool readValue(std::ifstream& file, T& value) {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    bool isKept(PortState state) {
+        return state == PortState::Open || state == PortState::Filtered;
+    }
+}
+
+std::uint64_t PortHistory::key(std::size_t targetIndex, int port) {
+    return (static_cast<std::uint64_t>(targetIndex) << 16) | static_cast<std::uint16_t>(port);
+}
+
+bool PortHistory::contains(std::size_t targetIndex, int port) const {
+    return entries.count(key(targetIndex, port)) > 0;
+}
+
+std::vector<TargetPort> PortHistory::hotProbes() const {
+    /**
+     * @brief Lists the ports a round between full sweeps has to probe.
+     *
+     * @return Every kept port, ordered by target and port so each host's probes stay together.
+     */
+    std::vector<std::uint64_t> keys;
+    keys.reserve(entries.size());
+    for (const auto& [entryKey, entry] : entries) {
+        keys.push_back(entryKey);
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<TargetPort> probes;
+    probes.reserve(keys.size());
+    for (std::uint64_t entryKey : keys) {
+        probes.push_back({ static_cast<std::size_t>(entryKey >> 16), static_cast<std::uint16_t>(entryKey & 0xFFFF) });
+    }
+    return probes;
+}
+
+std::vector<PortChange> PortHistory::update(const ResultStore& results) {
+    /**
+     * @brief Compares a finished round with the previous state of its ports.
+     *
+     * Every kept port was probed, so one the round didn't record as open or filtered has
+     * closed. Ports recorded open or filtered that aren't kept yet have opened (or turned
+     * filtered) since the last round. Closed ports are dropped once they have stayed closed for
+     * RECENT_ROUNDS rounds.
+     *
+     * @param results The ports recorded by the round.
+     * @return The ports whose state changed.
+     */
+    completedRounds++;
+    std::vector<PortChange> changes;
+    for (auto it = entries.begin(); it != entries.end();) {
+        std::size_t targetIndex = static_cast<std::size_t>(it->first >> 16);
+        int port = static_cast<int>(it->first & 0xFFFF);
+        PortState state = results.stateFor(targetIndex, port);
+        if (!isKept(state)) {
+            state = PortState::Closed;
+        }
+        Entry& entry = it->second;
+        if (state != entry.state) {
+            changes.push_back({ targetIndex, PortInfo{ port, state }, entry.state });
+            entry = Entry{ state, completedRounds };
+        }
+        if (entry.state == PortState::Closed && completedRounds - entry.changedRound >= RECENT_ROUNDS) {
+            it = entries.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    for (std::size_t targetIndex : results.reportedTargets()) {
+        for (const PortInfo& portInfo : results.portsFor(targetIndex)) {
+            if (isKept(portInfo.status) && entries.try_emplace(key(targetIndex, portInfo.port), Entry{ portInfo.status, completedRounds }).second) {
+                changes.push_back({ targetIndex, portInfo, PortState::Closed });
+            }
+        }
+    }
+    std::sort(changes.begin(), changes.end(), [](const PortChange& a, const PortChange& b) {
+        return std::tie(a.targetIndex, a.portInfo.port) < std::tie(b.targetIndex, b.portInfo.port);
+        });
+    return changes;
+}
+
+std::uint32_t PortHistory::rounds() const {
+    return completedRounds;
+}
+
+std::size_t PortHistory::size() const {
+    return entries.size();
+}
+
+bool PortHistory::save(const std::string& path) const {
+    /**
+     * @brief Writes the history next to `path` and renames it into place.
+     *
+     * Layout: magic, fingerprint, completed rounds, entry count, then one (target index, port,
+     * state, round of the last change) record per kept port.
+     *
+     * @param path The state file.
+     * @return false if the file could not be written.
+     */
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file.write(MAGIC, sizeof(MAGIC));
+        writeValue<std::uint64_t>(file, fingerprint);
+        writeValue<std::uint32_t>(file, completedRounds);
+        writeValue<std::uint64_t>(file, entries.size());
+        for (const auto& [entryKey, entry] : entries) {
+            writeValue<std::uint64_t>(file, entryKey >> 16);
+            writeValue<std::uint16_t>(file, static_cast<std::uint16_t>(entryKey & 0xFFFF));
+            writeValue<std::uint8_t>(file, static_cast<std::uint8_t>(entry.state));
+            writeValue<std::uint32_t>(file, entry.changedRound);
+        }
+        if (!file.flush()) {
+            return false;
+        }
+    }
+#ifdef _WIN32
+    // rename() doesn't replace an existing file on Windows.
+    std::remove(path.c_str());
+#endif
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+std::optional<PortHistory> PortHistory::load(const std::string& path) {
+    /**
+     * @brief Reads a state file.
+     *
+     * @param path The state file.
+     * @return The history, or std::nullopt if it can't be read or isn't a state file.
+     */
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if (!file || !file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        return std::nullopt;
+    }
+    PortHistory history;
+    std::uint64_t entryCount;
+    if (!readValue(file, history.fingerprint) || !readValue(file, history.completedRounds) || !readValue(file, entryCount)) {
+        return std::nullopt;
+    }
+    for (std::uint64_t i = 0; i < entryCount; ++i) {
+        std::uint64_t targetIndex;
+        std::uint16_t port;
+        std::uint8_t state;
+        std::uint32_t changedRound;
+        if (!readValue(file, targetIndex) || !readValue(file, port) || !readValue(file, state) || !readValue(file, changedRound)
+            || state > static_cast<std::uint8_t>(PortState::Unknown)) {
+            return std::nullopt;
+        }
+        history.entries[key(static_cast<std::size_t>(targetIndex), port)] = Entry{ static_cast<PortState>(state), changedRound };
+    }
+    return history;
+}
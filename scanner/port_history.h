@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "probe_source.h"
+#include "result_store.h"
+
+// A port whose state differs from the previous round of a watch scan.
+struct PortChange {
+    std::size_t targetIndex;
+    // The port and its new state.
+    PortInfo portInfo;
+    PortState previous;
+};
+
+// The last known state of every port of a watch scan that is worth probing again between full
+// sweeps: open and filtered ports, and closed ports for RECENT_ROUNDS rounds after they closed.
+// A port that isn't kept is closed or never answered, so the stable closed ports that make up
+// nearly all of a scan cost nothing. Stored as a small binary file like a Checkpoint.
+class PortHistory {
+public:
+    // The rounds a port that closed keeps being probed between full sweeps.
+    static constexpr std::uint32_t RECENT_ROUNDS = 3;
+
+    // Whether the port is kept, i.e. it was open or filtered or changed recently.
+    bool contains(std::size_t targetIndex, int port) const;
+    // The ports probed between full sweeps, ordered by target and port.
+    std::vector<TargetPort> hotProbes() const;
+    // Folds in the results of a round that probed at least every port of `hotProbes()` and
+    // returns what changed, ordered by target and port.
+    std::vector<PortChange> update(const ResultStore& results);
+    // The rounds folded in since the history was started.
+    std::uint32_t rounds() const;
+    // The amount of ports kept.
+    std::size_t size() const;
+
+    // Writes the history to `path` through a temporary file; returns false on an I/O error.
+    bool save(const std::string& path) const;
+    // Reads a history written by `save()`, or nothing if the file is missing or malformed.
+    static std::optional<PortHistory> load(const std::string& path);
+
+    // Identifies the targets and ports of the scan, so a history is never applied to a different scan.
+    std::uint64_t fingerprint = 0;
+
+private:
+    struct Entry {
+        PortState state;
+        // The round the port last changed state in.
+        std::uint32_t changedRound;
+    };
+
+    static std::uint64_t key(std::size_t targetIndex, int port);
+
+    std::unordered_map<std::uint64_t, Entry> entries;
+    std::uint32_t completedRounds = 0;
+};
@@ -0,0 +1,59 @@
+#include "probe_pool.h"
+
+ProbePool::ProbePool(const boost::asio::any_io_executor& executor, int size, bool useStrands) {
+    /**
+     * @brief Creates every slot up front so the probe path never allocates.
+     *
+     * @param executor The executor the sockets and timers run on.
+     * @param size The amount of slots, the largest amount of probes that can be in flight.
+     * @param useStrands Give every slot its own strand; only needed when several threads run `executor`.
+     */
+    slots.reserve(size);
+    freeSlots.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        slots.push_back(std::make_unique<ProbeSlot>(executor, useStrands));
+        slots.back()->id = static_cast<std::size_t>(i);
+        freeSlots.push_back(slots.back().get());
+    }
+}
+
+ProbeSlot* ProbePool::acquire() {
+    /**
+     * @brief Takes a free slot off the pool.
+     *
+     * @return A free slot, or nullptr if every slot is in use.
+     */
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (freeSlots.empty()) {
+        return nullptr;
+    }
+    ProbeSlot* slot = freeSlots.back();
+    freeSlots.pop_back();
+    return slot;
+}
+
+void ProbePool::release(ProbeSlot* slot) {
+    /**
+     * @brief Returns a slot to the pool once its probe is finished.
+     *
+     * @param slot The slot handed out by `acquire()`.
+     */
+    std::lock_guard<std::mutex> lock(poolMutex);
+    freeSlots.push_back(slot);
+}
+
+void ProbePool::cancelAll() {
+    /**
+     * @brief Cuts every probe in flight short, e.g. when a scan is cancelled.
+     *
+     * Free slots have nothing pending, so cancelling them is harmless.
+     */
+    for (std::unique_ptr<ProbeSlot>& slot : slots) {
+        ProbeSlot* current = slot.get();
+        boost::asio::post(current->executor, [current]() {
+            boost::system::error_code ignore;
+            current->socket.cancel(ignore);
+            current->timer.cancel(ignore);
+            });
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Everything one in-flight probe needs. Slots are created once and recycled, so the
+// socket, timer and executor are reused from probe to probe.
+struct ProbeSlot {
+    ProbeSlot(const boost::asio::any_io_executor& shardExecutor, bool useStrand)
+        : executor(useStrand
+            ? boost::asio::any_io_executor(boost::asio::make_strand(shardExecutor))
+            : shardExecutor),
+        socket(executor),
+        timer(executor)
+    {
+    }
+
+    // A strand when several threads may run the shard's executor, otherwise that executor itself.
+    boost::asio::any_io_executor executor;
+    boost::asio::ip::tcp::socket socket;
+    // Connect deadline, and the wait for a rate capped send.
+    boost::asio::steady_timer timer;
+
+    // The slot's position in the pool, used to track its probe in the ProbeSource.
+    std::size_t id = 0;
+    std::size_t targetIndex = 0;
+    int port = 0;
+    std::chrono::steady_clock::time_point sentAt;
+    // Bumped for every connect so stale timer callbacks can recognise they are outdated.
+    std::uint64_t generation = 0;
+    bool completed = false;
+};
+
+// A fixed amount of probe slots, sized to the largest allowed connection window.
+class ProbePool {
+public:
+    ProbePool(const boost::asio::any_io_executor& executor, int size, bool useStrands);
+
+    // Takes a free slot. Callers must hold a `ConnectionLimiter` slot, which guarantees one is free.
+    ProbeSlot* acquire();
+    // Hands a finished slot back to the pool.
+    void release(ProbeSlot* slot);
+    // Aborts the connect and the timer wait of every slot, on each slot's executor.
+    void cancelAll();
+
+private:
+    std::vector<std::unique_ptr<ProbeSlot>> slots;
+    std::vector<ProbeSlot*> freeSlots;
+    std::mutex poolMutex;
+};
@@ -0,0 +1,208 @@
+#include "probe_source.h"
+
+#include <algorithm>
+
+ProbeSource::ProbeSource(std::size_t targetCount, const std::vector<std::uint16_t>& ports, std::size_t shardIndex, std::size_t shardCount, std::size_t slotCount,
+    const std::vector<std::size_t>* targetIndexes, std::optional<std::uint64_t> orderSeed, const std::vector<TargetPort>* pairs, std::size_t lateTargets)
+    : targetCount(pairs ? pairs->size() : targetIndexes ? targetIndexes->size() : targetCount),
+    targetIndexes(targetIndexes),
+    pairs(pairs),
+    ports(ports),
+    portCount(pairs ? 1 : ports.size()),
+    cursor(0),
+    slotCount(slotCount),
+    slotProbes(new std::atomic<std::uint64_t>[slotCount])
+{
+    /**
+     * @brief Picks the part of the space this source walks.
+     *
+     * A shuffled walk takes an even slice of the permutation's positions. Otherwise the shard
+     * takes a block of the targets, or of the ports when there are fewer targets than shards,
+     * and numbers its probes from where the blocks of the shards before it end, so the probe
+     * indexes of every shard of a scan are distinct.
+     *
+     * @param targetCount The amount of targets in the space; ignored with `targetIndexes` or `pairs`.
+     * @param ports The ports of every target; must outlive the source.
+     * @param shardIndex The shard this source belongs to.
+     * @param shardCount The amount of shards the space is split into.
+     * @param slotCount The amount of probe slots tracked for `finishedBelow()`.
+     * @param targetIndexes The targets to walk, or nullptr for every target.
+     * @param orderSeed Shuffles the walk when set.
+     * @param pairs The pairs to walk instead of the target x port space, or nullptr.
+     * @param lateTargets The amount of targets at the end that are walked after the others.
+     */
+    std::uint64_t total = static_cast<std::uint64_t>(this->targetCount) * portCount;
+    std::size_t shards = std::max<std::size_t>(1, shardCount);
+    if (orderSeed) {
+        order.emplace(total, *orderSeed);
+        first = total * shardIndex / shards;
+        last = total * (shardIndex + 1) / shards;
+    }
+    else if (this->targetCount >= shards) {
+        firstTarget = this->targetCount * shardIndex / shards;
+        blockTargets = this->targetCount * (shardIndex + 1) / shards - firstTarget;
+        blockPorts = portCount;
+        first = static_cast<std::uint64_t>(firstTarget) * portCount;
+    }
+    else {
+        blockTargets = this->targetCount;
+        firstPort = portCount * shardIndex / shards;
+        blockPorts = portCount * (shardIndex + 1) / shards - firstPort;
+        first = firstPort * this->targetCount;
+    }
+    if (!orderSeed) {
+        last = first + static_cast<std::uint64_t>(blockTargets) * blockPorts;
+        // Only the late targets that fall into this block.
+        std::size_t lateFrom = this->targetCount - std::min(lateTargets, this->targetCount);
+        this->lateTargets = firstTarget + blockTargets > lateFrom ? firstTarget + blockTargets - std::max(firstTarget, lateFrom) : 0;
+    }
+    cursor.store(first);
+    for (std::size_t i = 0; i < slotCount; ++i) {
+        slotProbes[i].store(IDLE);
+    }
+}
+
+std::optional<Probe> ProbeSource::next() {
+    /**
+     * @brief Produces the next (target, port) pair in the scan.
+     *
+     * The targets of the block take turns: the first port goes to every target, then the second
+     * one and so on, with the late targets getting their turns after that; given pairs are
+     * walked in list order. A shuffled order maps the index through the permutation instead. The
+     * position is a single atomic counter, so the source never holds more than one integer of
+     * state no matter how large the scan is.
+     *
+     * @return The next probe, or std::nullopt once the scan space is exhausted.
+     */
+    std::uint64_t index = cursor.fetch_add(1, std::memory_order_relaxed);
+    if (index >= last) {
+        return std::nullopt;
+    }
+    std::size_t target;
+    std::uint64_t port;
+    if (order) {
+        std::uint64_t position = order->at(index);
+        target = static_cast<std::size_t>(position % targetCount);
+        port = position / targetCount;
+    }
+    else {
+        std::uint64_t offset = index - first;
+        std::size_t earlyTargets = blockTargets - lateTargets;
+        std::uint64_t earlyProbes = static_cast<std::uint64_t>(earlyTargets) * blockPorts;
+        if (offset < earlyProbes) {
+            target = firstTarget + static_cast<std::size_t>(offset % earlyTargets);
+            port = firstPort + offset / earlyTargets;
+        }
+        else {
+            offset -= earlyProbes;
+            target = firstTarget + earlyTargets + static_cast<std::size_t>(offset % lateTargets);
+            port = firstPort + offset / lateTargets;
+        }
+    }
+    if (pairs) {
+        const TargetPort& pair = (*pairs)[target];
+        return Probe{ pair.targetIndex, pair.port, index };
+    }
+    return Probe{
+        targetIndexes ? (*targetIndexes)[target] : target,
+        static_cast<int>(ports[static_cast<std::size_t>(port)]),
+        index
+    };
+}
+
+std::optional<Probe> ProbeSource::next(std::size_t slot) {
+    /**
+     * @brief Produces the next probe and records it against `slot`.
+     *
+     * The slot is first marked with the current cursor, which is never above the index about
+     * to be claimed, and only then is the index claimed. `finishedBelow()` reads the cursor
+     * before the slots, so it can't miss a probe that is between the two steps.
+     *
+     * @param slot The slot the probe will run in, below `slotCount`.
+     * @return The next probe, or std::nullopt once the scan space is exhausted.
+     */
+    slotProbes[slot].store(cursor.load());
+    std::optional<Probe> probe = next();
+    slotProbes[slot].store(probe ? probe->index : IDLE);
+    return probe;
+}
+
+void ProbeSource::finish(std::size_t slot) {
+    slotProbes[slot].store(IDLE);
+}
+
+void ProbeSource::park(std::size_t slot, const Probe& probe, std::size_t key) {
+    /**
+     * @brief Takes the probe `slot` was just handed out of the slot and keeps it for later.
+     *
+     * @param slot The slot that got the probe from `next(slot)`.
+     * @param probe The probe to park.
+     * @param key What the probe waits on, e.g. its target's slot in the HostScheduler.
+     */
+    std::lock_guard<std::mutex> lock(parkedMutex);
+    parked.emplace(key, probe);
+    parkedProbes.fetch_add(1, std::memory_order_relaxed);
+    slotProbes[slot].store(IDLE);
+}
+
+std::optional<Probe> ProbeSource::unpark(std::size_t slot, std::size_t key) {
+    /**
+     * @brief Hands a parked probe to `slot`, which then holds it until `finish(slot)`.
+     *
+     * @param slot The slot that will run the probe.
+     * @param key The key the probe was parked under.
+     * @return The probe, or std::nullopt if nothing is parked under `key`.
+     */
+    if (parkedProbes.load(std::memory_order_relaxed) == 0) {
+        return std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(parkedMutex);
+    auto it = parked.find(key);
+    if (it == parked.end()) {
+        return std::nullopt;
+    }
+    Probe probe = it->second;
+    slotProbes[slot].store(probe.index);
+    parked.erase(it);
+    parkedProbes.fetch_sub(1, std::memory_order_relaxed);
+    return probe;
+}
+
+std::size_t ProbeSource::parkedCount() const {
+    return parkedProbes.load(std::memory_order_relaxed);
+}
+
+std::uint64_t ProbeSource::finishedBelow() const {
+    /**
+     * @brief The index below which every probe has completed.
+     *
+     * @return The lowest probe still in flight or parked, or the cursor when nothing is.
+     */
+    std::lock_guard<std::mutex> lock(parkedMutex);
+    std::uint64_t lowest = std::min(cursor.load(), last);
+    for (std::size_t i = 0; i < slotCount; ++i) {
+        lowest = std::min(lowest, slotProbes[i].load());
+    }
+    for (const auto& [key, probe] : parked) {
+        lowest = std::min(lowest, probe.index);
+    }
+    return lowest;
+}
+
+void ProbeSource::resumeAt(std::uint64_t index) {
+    /**
+     * @brief Moves the cursor forward to `index`; must be called before the scan starts.
+     *
+     * @param index A value returned by `finishedBelow()` in an earlier run of the same scan.
+     */
+    cursor.store(std::clamp(index, first, last));
+}
+
+std::uint64_t ProbeSource::total() const {
+    /**
+     * @brief The amount of probes this source will hand out in total.
+     *
+     * @return targets * ports, or the size of the slice when the space is sharded
+     */
+    return last - first;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "permutation.h"
+
+// A (target, port) pair picked out of the target x port space.
+struct TargetPort {
+    std::size_t targetIndex;
+    std::uint16_t port;
+};
+
+// A single (target, port) pair waiting to be probed.
+struct Probe {
+    std::size_t targetIndex;
+    int port;
+    // The position of the probe in the scan order.
+    std::uint64_t index;
+};
+
+// Lazily walks the target x port space, handing out one probe at a time so nothing
+// has to be queued up front. Safe to call `next()` from any reactor thread. The targets are
+// walked round robin, every target getting a port before any target gets the next one, so
+// consecutive probes hit different hosts. With more than one shard, each source only walks its
+// own block of the space: a run of the targets with every port, or every target with a run of
+// the ports when there are fewer targets than shards. `ports` must outlive the source.
+//
+// The last `lateTargets` targets, e.g. domains that are still being resolved, only take their
+// turns once every other target of the block has had all of its ports.
+//
+// With `slotCount` above zero the source also remembers which probe each slot is working
+// on, so `finishedBelow()` can tell a checkpoint how far the scan is actually done rather
+// than just handed out. A probe can also be parked while its target has no room for it and
+// picked up later by any slot; it keeps counting as unfinished until then.
+//
+// With `targetIndexes` the source only walks those targets, e.g. the hosts that answered
+// host discovery; the list must outlive the source like `ports`.
+//
+// With an `orderSeed` the scan order is a Permutation of the whole target x port space
+// instead of the round robin, so every shard's slice is spread over every target and port. Probe indexes and checkpoints count
+// positions in that order, so a resumed scan has to use the same seed. Late targets aren't held
+// back in a shuffled order.
+//
+// With `pairs` the source walks exactly those pairs instead of a target x port space, e.g. the
+// ports a watch round probes again; the targets and ports are then ignored. The list must
+// outlive the source like `ports`.
+class ProbeSource {
+public:
+    ProbeSource(std::size_t targetCount, const std::vector<std::uint16_t>& ports, std::size_t shardIndex = 0, std::size_t shardCount = 1, std::size_t slotCount = 0,
+        const std::vector<std::size_t>* targetIndexes = nullptr, std::optional<std::uint64_t> orderSeed = std::nullopt,
+        const std::vector<TargetPort>* pairs = nullptr, std::size_t lateTargets = 0);
+
+    // Produces the next probe, or nothing once every target and port has been handed out.
+    std::optional<Probe> next();
+    // Like `next()`, and records that `slot` is working on the probe until `finish(slot)`.
+    std::optional<Probe> next(std::size_t slot);
+    // Marks the probe held by `slot` as done.
+    void finish(std::size_t slot);
+    // Sets the probe `slot` was handed aside under `key` (whatever its target waits on) until
+    // there is room for it; the slot is free afterwards.
+    void park(std::size_t slot, const Probe& probe, std::size_t key);
+    // Moves a probe parked under `key` into `slot`.
+    std::optional<Probe> unpark(std::size_t slot, std::size_t key);
+    // The amount of probes parked.
+    std::size_t parkedCount() const;
+    // Every probe of this source below the returned index has finished.
+    std::uint64_t finishedBelow() const;
+    // Skips everything below `index`, e.g. the work a resumed checkpoint already did.
+    void resumeAt(std::uint64_t index);
+    // The amount of probes this source will produce.
+    std::uint64_t total() const;
+
+private:
+    // The amount of targets walked.
+    std::size_t targetCount;
+    // Maps the walked targets to indexes in the target space, or nullptr to walk every target.
+    const std::vector<std::size_t>* targetIndexes;
+    // The pairs walked instead of the target x port space, or nullptr.
+    const std::vector<TargetPort>* pairs;
+    // The ports of every target, in the order they are probed.
+    const std::vector<std::uint16_t>& ports;
+    std::uint64_t portCount;
+    // The block of the round robin walk: `blockTargets` targets from `firstTarget`, of which
+    // the last `lateTargets` go last, with `blockPorts` ports from `firstPort`.
+    std::size_t firstTarget = 0;
+    std::size_t blockTargets = 0;
+    std::size_t lateTargets = 0;
+    std::uint64_t firstPort = 0;
+    std::uint64_t blockPorts = 0;
+    // The probe indexes this source hands out: [first, last).
+    std::uint64_t first = 0;
+    std::uint64_t last = 0;
+    std::atomic<std::uint64_t> cursor;
+    // Shuffles the walk when a seed was given.
+    std::optional<Permutation> order;
+
+    static constexpr std::uint64_t IDLE = std::numeric_limits<std::uint64_t>::max();
+    std::size_t slotCount;
+    // The probe index each slot is working on, or IDLE.
+    std::unique_ptr<std::atomic<std::uint64_t>[]> slotProbes;
+    // The parked probes by key. Parking and unparking move a probe between here and a slot
+    // under the lock, which `finishedBelow()` takes too, so it is always seen in one of them.
+    mutable std::mutex parkedMutex;
+    std::unordered_multimap<std::size_t, Probe> parked;
+    std::atomic<std::size_t> parkedProbes{ 0 };
+};
@@ -0,0 +1,44 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+
+RateLimiter::RateLimiter(double rate, std::size_t buckets)
+    : interval(rate > 0 ? std::max<std::int64_t>(1, static_cast<std::int64_t>(1e9 / rate)) : 0),
+    tolerance(interval * std::max<std::int64_t>(1, static_cast<std::int64_t>(rate / 10000))),
+    bucketCount(rate > 0 ? std::max<std::size_t>(1, buckets) : 0),
+    nextSend(new std::atomic<std::int64_t>[bucketCount])
+{
+    for (std::size_t i = 0; i < bucketCount; ++i) {
+        nextSend[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+bool RateLimiter::enabled() const {
+    return interval > 0;
+}
+
+std::chrono::steady_clock::time_point RateLimiter::reserve(std::size_t key) {
+    /**
+     * @brief Claims the next send slot of a bucket.
+     *
+     * A bucket that fell behind the clock by more than its tolerance is pulled forward first,
+     * so an idle bucket can't bank an unlimited burst. Reservations in the past mean the
+     * caller is allowed to send right away.
+     *
+     * @param key The target index for per target buckets, ignored with a single bucket.
+     * @return The time the packet may be sent.
+     */
+    auto now = std::chrono::steady_clock::now();
+    if (!enabled()) {
+        return now;
+    }
+    std::int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+    std::atomic<std::int64_t>& bucket = nextSend[key % bucketCount];
+    std::int64_t next = bucket.load(std::memory_order_relaxed);
+    std::int64_t sendAt;
+    do {
+        sendAt = std::max(next, nowNs - tolerance);
+    } while (!bucket.compare_exchange_weak(next, sendAt + interval, std::memory_order_relaxed));
+    return std::max(now, std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(sendAt))));
+}
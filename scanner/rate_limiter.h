@@ -0,0 +1,32 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// Paces packets to a fixed rate with token buckets in their GCRA form: each bucket is a single
+// atomic "next send time", so reserving a send is one compare and swap and the pacing has
+// nanosecond resolution. After a quiet spell a bucket lets a short burst through (a tenth of a
+// millisecond worth of packets, at least one) and then spaces the packets evenly.
+//
+// With more than one bucket, `reserve(key)` uses bucket `key % buckets`, which is how the
+// per target cap shares a bounded table between any amount of targets.
+class RateLimiter {
+public:
+    // `rate` packets per second per bucket; a rate of 0 turns the limiter off.
+    RateLimiter(double rate, std::size_t buckets = 1);
+
+    // True if a rate was set.
+    bool enabled() const;
+    // Claims the next send in the bucket of `key` and returns when the packet may go out.
+    std::chrono::steady_clock::time_point reserve(std::size_t key = 0);
+
+private:
+    // Nanoseconds between two packets of the same bucket.
+    std::int64_t interval;
+    // How far a bucket may fall behind the clock, i.e. the burst it allows.
+    std::int64_t tolerance;
+    std::size_t bucketCount;
+    // Per bucket, the earliest time (steady clock nanoseconds) the next packet may be sent.
+    std::unique_ptr<std::atomic<std::int64_t>[]> nextSend;
+};
@@ -0,0 +1,205 @@
+#include "result_store.h"
+#include "lazy_pointer.h"
+
+ResultStore::ResultStore(std::size_t targetCount)
+    : targetCount(targetCount),
+    pageCount((targetCount + PAGE_SIZE - 1) / PAGE_SIZE),
+    pages(new std::atomic<Page*>[pageCount])
+{
+    /**
+     * @brief Creates an empty store for `targetCount` targets.
+     *
+     * Only a pointer per page of targets is reserved; the pages and the state tables
+     * themselves are allocated lazily.
+     */
+    for (std::size_t i = 0; i < pageCount; ++i) {
+        pages[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ResultStore::~ResultStore() {
+    for (std::size_t i = 0; i < pageCount; ++i) {
+        Page* page = pages[i].load(std::memory_order_relaxed);
+        if (!page) {
+            continue;
+        }
+        for (std::atomic<TargetPorts*>& table : page->tables) {
+            delete table.load(std::memory_order_relaxed);
+        }
+        delete page;
+    }
+}
+
+ResultStore::TargetPorts& ResultStore::portsForWrite(std::size_t targetIndex) {
+    /**
+     * @brief Fetches the state table for a target, allocating it and its page on first use.
+     *
+     * @param targetIndex The index of the target in the scanner's target list.
+     * @return The target's state table.
+     */
+    Page& page = loadOrCreate(pages[targetIndex / PAGE_SIZE]);
+    return loadOrCreate(page.tables[targetIndex % PAGE_SIZE]);
+}
+
+const ResultStore::TargetPorts* ResultStore::portsForRead(std::size_t targetIndex) const {
+    /**
+     * @brief Fetches the state table for a target without allocating anything.
+     *
+     * @param targetIndex The index of the target in the scanner's target list.
+     * @return The target's state table, or nullptr if it has no results.
+     */
+    const Page* page = pages[targetIndex / PAGE_SIZE].load(std::memory_order_acquire);
+    if (!page) {
+        return nullptr;
+    }
+    return page->tables[targetIndex % PAGE_SIZE].load(std::memory_order_acquire);
+}
+
+bool ResultStore::record(std::size_t targetIndex, PortInfo portInfo) {
+    /**
+     * @brief Records the state of a port without taking any lock.
+     *
+     * The first state recorded for a port wins, which makes deduplication a compare and swap
+     * on the word holding the port's two bits.
+     *
+     * @param targetIndex The index of the target in the scanner's target list.
+     * @param portInfo The port and the state it was found in.
+     * @return true if this is the first time the port was recorded for the target.
+     */
+    if (portInfo.status == PortState::Unknown) {
+        return false;
+    }
+    std::uint16_t port = static_cast<std::uint16_t>(portInfo.port);
+    PortChunk& chunk = loadOrCreate(portsForWrite(targetIndex).chunks[port / CHUNK_PORTS]);
+    std::atomic<std::uint64_t>& word = chunk.words[(port % CHUNK_PORTS) / PORTS_PER_WORD];
+    int shift = (port % PORTS_PER_WORD) * 2;
+    std::uint64_t encoded = static_cast<std::uint64_t>(static_cast<int>(portInfo.status) + 1) << shift;
+    std::uint64_t current = word.load(std::memory_order_relaxed);
+    do {
+        if (current & (std::uint64_t(3) << shift)) {
+            return false;
+        }
+    } while (!word.compare_exchange_weak(current, current | encoded, std::memory_order_relaxed));
+    return true;
+}
+
+void ResultStore::merge(const ResultStore& other) {
+    /**
+     * @brief Folds the results of another store into this one.
+     *
+     * Used once a sharded scan has finished, so only the tables the other store actually
+     * allocated are walked.
+     *
+     * @param other A store for the same list of targets.
+     */
+    for (std::size_t targetIndex : other.reportedTargets()) {
+        for (const PortInfo& portInfo : other.portsFor(targetIndex)) {
+            record(targetIndex, portInfo);
+        }
+    }
+    std::scoped_lock lock(servicesMutex, other.servicesMutex);
+    services.insert(other.services.begin(), other.services.end());
+}
+
+std::vector<PortInfo> ResultStore::portsFor(std::size_t targetIndex) const {
+    /**
+     * @brief Collects the recorded ports of a target.
+     *
+     * @param targetIndex The index of the target in the scanner's target list.
+     * @return The recorded ports, sorted by port number.
+     */
+    std::vector<PortInfo> ports;
+    const TargetPorts* table = portsForRead(targetIndex);
+    if (!table) {
+        return ports;
+    }
+    for (std::size_t chunkIndex = 0; chunkIndex < table->chunks.size(); ++chunkIndex) {
+        const PortChunk* chunk = table->chunks[chunkIndex].load(std::memory_order_acquire);
+        if (!chunk) {
+            continue;
+        }
+        for (std::size_t wordIndex = 0; wordIndex < chunk->words.size(); ++wordIndex) {
+            std::uint64_t word = chunk->words[wordIndex].load(std::memory_order_relaxed);
+            for (int i = 0; word; ++i, word >>= 2) {
+                if (word & 3) {
+                    int port = static_cast<int>(chunkIndex * CHUNK_PORTS + wordIndex * PORTS_PER_WORD) + i;
+                    ports.push_back({ port, static_cast<PortState>((word & 3) - 1) });
+                }
+            }
+        }
+    }
+    return ports;
+}
+
+PortState ResultStore::stateFor(std::size_t targetIndex, int port) const {
+    /**
+     * @brief Looks up the recorded state of a single port.
+     *
+     * @param targetIndex The index of the target in the scanner's target list.
+     * @param port The port to look up.
+     * @return The recorded state, or PortState::Unknown if the port wasn't recorded.
+     */
+    const TargetPorts* table = portsForRead(targetIndex);
+    if (!table) {
+        return PortState::Unknown;
+    }
+    std::uint16_t index = static_cast<std::uint16_t>(port);
+    const PortChunk* chunk = table->chunks[index / CHUNK_PORTS].load(std::memory_order_acquire);
+    if (!chunk) {
+        return PortState::Unknown;
+    }
+    std::uint64_t word = chunk->words[(index % CHUNK_PORTS) / PORTS_PER_WORD].load(std::memory_order_relaxed);
+    std::uint64_t encoded = (word >> ((index % PORTS_PER_WORD) * 2)) & 3;
+    return encoded ? static_cast<PortState>(encoded - 1) : PortState::Unknown;
+}
+
+std::vector<std::size_t> ResultStore::reportedTargets() const {
+    /**
+     * @brief Lists the targets that have reported at least one port.
+     *
+     * Pages that were never allocated are skipped whole, so this stays cheap for large
+     * target spaces where only a few hosts answer.
+     *
+     * @return The target indices in ascending order.
+     */
+    std::vector<std::size_t> reported;
+    for (std::size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex) {
+        const Page* page = pages[pageIndex].load(std::memory_order_acquire);
+        if (!page) {
+            continue;
+        }
+        for (std::size_t i = 0; i < PAGE_SIZE; ++i) {
+            if (page->tables[i].load(std::memory_order_acquire)) {
+                reported.push_back(pageIndex * PAGE_SIZE + i);
+            }
+        }
+    }
+    return reported;
+}
+
+void ResultStore::recordService(std::size_t targetIndex, int port, const std::string& service) {
+    /**
+     * @brief Records the service identified on a port.
+     *
+     * Recorded names are never replaced, which keeps the views handed out by `serviceFor()` valid.
+     *
+     * @param targetIndex The index of the target in the scanner's target list.
+     * @param port The port the service answered on.
+     * @param service The name of the service.
+     */
+    std::lock_guard<std::mutex> lock(servicesMutex);
+    services.emplace((static_cast<std::uint64_t>(targetIndex) << 16) | static_cast<std::uint16_t>(port), service);
+}
+
+std::string_view ResultStore::serviceFor(std::size_t targetIndex, int port) const {
+    /**
+     * @brief Looks up the service identified on a port.
+     *
+     * @param targetIndex The index of the target in the scanner's target list.
+     * @param port The port to look up.
+     * @return The service, or an empty view if none was identified.
+     */
+    std::lock_guard<std::mutex> lock(servicesMutex);
+    auto it = services.find((static_cast<std::uint64_t>(targetIndex) << 16) | static_cast<std::uint16_t>(port));
+    return it != services.end() ? std::string_view(it->second) : std::string_view();
+}
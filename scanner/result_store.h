@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class PortState {
+    Open,
+    Closed,
+    Filtered,
+    Unknown
+};
+
+struct PortInfo {
+    int port;
+    PortState status;
+};
+
+// Lock-free scan results: two bits of state per port, in chunks of CHUNK_PORTS ports that are
+// allocated the first time a target reports a port in them. The per target chunk tables are
+// grouped in pages that are also allocated on first use, so hosts that never report cost next
+// to nothing and a host that reports a few hundred ports costs about a kilobyte.
+class ResultStore {
+public:
+    explicit ResultStore(std::size_t targetCount);
+    ~ResultStore();
+
+    ResultStore(const ResultStore&) = delete;
+    ResultStore& operator=(const ResultStore&) = delete;
+
+    // Records the state of a port; returns false if the port was already recorded. Unknown
+    // states aren't stored, as they read back the same as an unrecorded port.
+    bool record(std::size_t targetIndex, PortInfo portInfo);
+    // Records every port of `other` that isn't recorded here yet.
+    void merge(const ResultStore& other);
+    // Collects the recorded ports of a target in ascending port order.
+    std::vector<PortInfo> portsFor(std::size_t targetIndex) const;
+    // The recorded state of a port, or Unknown if it wasn't recorded.
+    PortState stateFor(std::size_t targetIndex, int port) const;
+    // The targets with at least one recorded port, in ascending order.
+    std::vector<std::size_t> reportedTargets() const;
+    // Records the service identified on a port by its banner; the first one recorded wins.
+    void recordService(std::size_t targetIndex, int port, const std::string& service);
+    // The service identified on a port, or an empty view if there is none. The view stays
+    // valid for the lifetime of the store.
+    std::string_view serviceFor(std::size_t targetIndex, int port) const;
+
+private:
+    static constexpr int CHUNK_PORTS = 1024;
+    static constexpr int PORTS_PER_WORD = 32;
+
+    struct PortChunk {
+        // Two bits per port: 0 means nothing recorded, otherwise the PortState + 1.
+        std::array<std::atomic<std::uint64_t>, CHUNK_PORTS / PORTS_PER_WORD> words{};
+    };
+
+    struct TargetPorts {
+        std::array<std::atomic<PortChunk*>, 65536 / CHUNK_PORTS> chunks{};
+
+        ~TargetPorts() {
+            for (std::atomic<PortChunk*>& chunk : chunks) {
+                delete chunk.load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    static constexpr std::size_t PAGE_SIZE = 4096;
+
+    struct Page {
+        std::array<std::atomic<TargetPorts*>, PAGE_SIZE> tables{};
+    };
+
+    // Fetches the table for a target, allocating it (and its page) if this is its first result.
+    TargetPorts& portsForWrite(std::size_t targetIndex);
+    // Fetches the table for a target, or nullptr if it hasn't reported anything.
+    const TargetPorts* portsForRead(std::size_t targetIndex) const;
+
+    std::size_t targetCount;
+    std::size_t pageCount;
+    std::unique_ptr<std::atomic<Page*>[]> pages;
+    // Identified services keyed by target index and port. Only open ports that answered end up
+    // here, so a locked map is plenty.
+    mutable std::mutex servicesMutex;
+    std::unordered_map<std::uint64_t, std::string> services;
+};
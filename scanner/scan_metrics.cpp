@@ -0,0 +1,130 @@
+#include "scan_metrics.h"
+#include "lazy_pointer.h"
+
+#include <algorithm>
+#include <bit>
+
+void LatencyHistogram::add(std::chrono::microseconds latency) {
+    std::uint64_t micros = static_cast<std::uint64_t>(std::max<std::int64_t>(latency.count(), 1));
+    std::size_t bucket = std::min<std::size_t>(std::bit_width(micros) - 1, BUCKETS - 1);
+    counts[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::count() const {
+    std::uint64_t total = 0;
+    for (const std::atomic<std::uint64_t>& bucket : counts) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::chrono::microseconds LatencyHistogram::quantile(double q) const {
+    /**
+     * @brief Estimates a quantile of the recorded latencies.
+     *
+     * The buckets double in width, so the estimate is off by at most a factor of two, which
+     * is plenty to tell a LAN from a WAN or a filtered network.
+     *
+     * @param q The quantile, e.g. 0.5 for the median.
+     * @return The upper bound of the bucket the quantile falls in.
+     */
+    std::array<std::uint64_t, BUCKETS> snapshot = buckets();
+    std::uint64_t total = 0;
+    for (std::uint64_t bucket : snapshot) {
+        total += bucket;
+    }
+    if (total == 0) {
+        return std::chrono::microseconds(0);
+    }
+    std::uint64_t rank = static_cast<std::uint64_t>(std::clamp(q, 0.0, 1.0) * static_cast<double>(total - 1));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKETS; ++i) {
+        seen += snapshot[i];
+        if (seen > rank) {
+            return std::chrono::microseconds(std::int64_t(1) << (i + 1));
+        }
+    }
+    return std::chrono::microseconds(std::int64_t(1) << BUCKETS);
+}
+
+std::array<std::uint64_t, LatencyHistogram::BUCKETS> LatencyHistogram::buckets() const {
+    std::array<std::uint64_t, BUCKETS> snapshot{};
+    for (std::size_t i = 0; i < BUCKETS; ++i) {
+        snapshot[i] = counts[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+ScanMetrics::ScanMetrics(std::size_t targetCount)
+    : pageCount((targetCount + PAGE_SIZE - 1) / PAGE_SIZE),
+    pages(new std::atomic<Page*>[pageCount])
+{
+    for (std::size_t i = 0; i < pageCount; ++i) {
+        pages[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+ScanMetrics::~ScanMetrics() {
+    for (std::size_t i = 0; i < pageCount; ++i) {
+        Page* page = pages[i].load(std::memory_order_relaxed);
+        if (!page) {
+            continue;
+        }
+        for (std::atomic<LatencyHistogram*>& histogram : page->histograms) {
+            delete histogram.load(std::memory_order_relaxed);
+        }
+        delete page;
+    }
+}
+
+void ScanMetrics::onSent() {
+    sent.fetch_add(1, std::memory_order_relaxed);
+    std::int64_t current = inFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+    std::int64_t peak = peakInFlight.load(std::memory_order_relaxed);
+    while (current > peak && !peakInFlight.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+    }
+}
+
+void ScanMetrics::onCompleted() {
+    inFlight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ScanMetrics::recordLatency(std::size_t targetIndex, std::chrono::microseconds latency) {
+    /**
+     * @brief Adds an answered probe to the overall histogram and to its target's.
+     *
+     * @param targetIndex The index of the target in the scanner's target list.
+     * @param latency The time between sending the probe and its answer.
+     */
+    all.add(latency);
+    Page& page = loadOrCreate(pages[targetIndex / PAGE_SIZE]);
+    loadOrCreate(page.histograms[targetIndex % PAGE_SIZE]).add(latency);
+}
+
+const LatencyHistogram& ScanMetrics::overall() const {
+    return all;
+}
+
+const LatencyHistogram* ScanMetrics::histogramFor(std::size_t targetIndex) const {
+    const Page* page = pages[targetIndex / PAGE_SIZE].load(std::memory_order_acquire);
+    if (!page) {
+        return nullptr;
+    }
+    return page->histograms[targetIndex % PAGE_SIZE].load(std::memory_order_acquire);
+}
+
+std::vector<std::size_t> ScanMetrics::measuredTargets() const {
+    std::vector<std::size_t> measured;
+    for (std::size_t pageIndex = 0; pageIndex < pageCount; ++pageIndex) {
+        const Page* page = pages[pageIndex].load(std::memory_order_acquire);
+        if (!page) {
+            continue;
+        }
+        for (std::size_t i = 0; i < PAGE_SIZE; ++i) {
+            if (page->histograms[i].load(std::memory_order_acquire)) {
+                measured.push_back(pageIndex * PAGE_SIZE + i);
+            }
+        }
+    }
+    return measured;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Connect latencies counted in power of two buckets of microseconds: bucket i holds the
+// latencies below 2^(i+1) us that don't fit a lower bucket, and the last one everything slower.
+class LatencyHistogram {
+public:
+    static constexpr std::size_t BUCKETS = 24;
+
+    void add(std::chrono::microseconds latency);
+    // The amount of latencies recorded.
+    std::uint64_t count() const;
+    // The upper bound of the bucket holding the `q` quantile (0-1), or zero without samples.
+    std::chrono::microseconds quantile(double q) const;
+    std::array<std::uint64_t, BUCKETS> buckets() const;
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKETS> counts{};
+};
+
+// Live counters of a scan, updated lock-free from the probe paths of every shard and read by
+// the status line and the final stats dump. Per target histograms are allocated the first time
+// the target answers, in pages like the ResultStore, so silent hosts cost nothing.
+class ScanMetrics {
+public:
+    explicit ScanMetrics(std::size_t targetCount);
+    ~ScanMetrics();
+
+    ScanMetrics(const ScanMetrics&) = delete;
+    ScanMetrics& operator=(const ScanMetrics&) = delete;
+
+    // A probe went out (a connect was started or a SYN was queued).
+    void onSent();
+    // A probe got its answer or gave up, so it is no longer in flight.
+    void onCompleted();
+    // Records the connect latency of an answered probe.
+    void recordLatency(std::size_t targetIndex, std::chrono::microseconds latency);
+
+    // The latencies of every target together.
+    const LatencyHistogram& overall() const;
+    // The latencies of one target, or nullptr if it never answered.
+    const LatencyHistogram* histogramFor(std::size_t targetIndex) const;
+    // The targets with a histogram, in ascending order.
+    std::vector<std::size_t> measuredTargets() const;
+
+    std::atomic<std::uint64_t> sent{ 0 };
+    std::atomic<std::int64_t> inFlight{ 0 };
+    // The most probes that were in flight at once.
+    std::atomic<std::int64_t> peakInFlight{ 0 };
+    std::atomic<std::uint64_t> open{ 0 };
+    std::atomic<std::uint64_t> refused{ 0 };
+    std::atomic<std::uint64_t> timeouts{ 0 };
+    // Probes sent again after the kernel ran out of sockets or buffers (EAGAIN, ENOBUFS).
+    std::atomic<std::uint64_t> retries{ 0 };
+    // Probes put off to a retry pass after a timeout or a failed send.
+    std::atomic<std::uint64_t> deferred{ 0 };
+    // Probes set aside while their target had its cap of probes in flight.
+    std::atomic<std::uint64_t> parked{ 0 };
+    // Times a congestion window shrank.
+    std::atomic<std::uint64_t> throttles{ 0 };
+
+private:
+    static constexpr std::size_t PAGE_SIZE = 4096;
+
+    struct Page {
+        std::array<std::atomic<LatencyHistogram*>, PAGE_SIZE> histograms{};
+    };
+
+    LatencyHistogram all;
+    std::size_t pageCount;
+    std::unique_ptr<std::atomic<Page*>[]> pages;
+};
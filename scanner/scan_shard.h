@@ -0,0 +1,76 @@
+#pragma once
+#include <boost/asio.hpp>
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "connection_limiter.h"
+#include "probe_pool.h"
+#include "probe_source.h"
+#include "result_store.h"
+#include "timing.h"
+
+// One independent slice of a scan. Every shard runs its own io_context and owns its part of
+// the target x port space, its connection budget, its probe slots and its results, so shards
+// never touch each other's state while the scan is running.
+//
+// Given an `externalExecutor` the shard runs on that instead of `ctx`, e.g. the executor of an
+// application embedding the scanner. The shard can't tell when such an executor runs out of
+// work, so it counts its own in `work` and calls `onFinished` once that drops to zero.
+struct ScanShard {
+    // `targetIndexes` limits the shard to those targets, `orderSeed` shuffles it, `pairs`
+    // replaces the target x port space with a list and `lateTargets` holds the last targets
+    // back, see ProbeSource.
+    ScanShard(std::size_t index, std::size_t shardCount, std::size_t targetCount, const std::vector<std::uint16_t>& ports,
+        const TimingTemplate& timingTemplate, int threadCount, const std::vector<std::size_t>* targetIndexes = nullptr,
+        std::optional<std::uint64_t> orderSeed = std::nullopt, const std::vector<TargetPort>* pairs = nullptr,
+        const boost::asio::any_io_executor& externalExecutor = {}, std::size_t lateTargets = 0)
+        : index(index),
+        threadCount(threadCount),
+        timingTemplate(timingTemplate),
+        ctx(threadCount),
+        executor(externalExecutor ? externalExecutor : boost::asio::any_io_executor(ctx.get_executor())),
+        probeSource(targetCount, ports, index, shardCount, timingTemplate.maxConnections, targetIndexes, orderSeed, pairs, lateTargets),
+        limiter(executor, timingTemplate.maxConnections),
+        congestionWindow(limiter, timingTemplate),
+        probePool(executor, timingTemplate.maxConnections, threadCount > 1 || externalExecutor),
+        results(targetCount)
+    {
+    }
+
+    ScanShard(const ScanShard&) = delete;
+    ScanShard& operator=(const ScanShard&) = delete;
+
+    std::size_t index;
+    // The amount of threads running `ctx`; probes only need strands when this is above one.
+    int threadCount;
+    // This shard's share of the connection budget.
+    TimingTemplate timingTemplate;
+    boost::asio::io_context ctx;
+    // `ctx`, or the executor the shard was given.
+    boost::asio::any_io_executor executor;
+    ProbeSource probeSource;
+    ConnectionLimiter limiter;
+    CongestionWindow congestionWindow;
+    ProbePool probePool;
+    // Merged into the scanner's results once every shard has finished.
+    ResultStore results;
+    // The probe launcher, the probes in flight and the banner reads still running.
+    std::atomic<std::int64_t> work{ 0 };
+    // Called by whichever thread finishes the last piece of `work`.
+    std::function<void()> onFinished;
+    // Set while the probe launcher waits for room among the parked probes; it keeps its piece
+    // of `work` meanwhile.
+    std::atomic<bool> isLauncherIdle{ false };
+    // Probes put off to a retry pass: the ones that timed out, pruned to targets that have
+    // answered once `pruneAt` is reached, and the ones the kernel failed to send.
+    std::mutex retryMutex;
+    std::vector<TargetPort> timedOut;
+    std::vector<TargetPort> failed;
+    std::size_t pruneAt = 65536;
+};
@@ -1,5 +1,25 @@
 #include "scanner.h"
 #include "fingerprint.h"
+#include "syn_scanner.h"
+
+namespace {
+    // A retry pass runs on this fraction of the connection budget, going easy on hosts that
+    // already dropped probes.
+    constexpr std::size_t RETRY_BUDGET_SHARE = 4;
+    // A shard parks at most this many probes per connection slot for targets at their cap, and
+    // never fewer than MIN_PARKED in all, so a small budget isn't stalled by a single slow host.
+    constexpr std::size_t PARKED_PER_SLOT = 4;
+    constexpr std::size_t MIN_PARKED = 4096;
+    // Without --max-host-connections a target may hold 1/HOST_SHARE of the connection budget,
+    // or an even share of it when fewer targets are scanned.
+    constexpr std::size_t HOST_SHARE = 8;
+    // Descriptors kept out of the connection budget for logs, output files and the event loops,
+    // on top of one per DNS lookup in flight.
+    constexpr std::size_t RESERVED_FILES = 128;
+    // Banner reads that have left their probe slot may hold up to 1/BANNER_SHARE of the
+    // connection budget in sockets on top of it.
+    constexpr int BANNER_SHARE = 4;
+}
 
 
 std::string state_to_string(PortState state) {
@@ -18,243 +38,584 @@ std::string state_to_string(PortState state) {
 }
 
 
-boost::optional<boost::asio::ip::address> Scanner::resolveDomainFromString(const std::string& domain) {
+bool Scanner::updateDictionary(ScanShard& shard, std::size_t targetIndex, PortInfo portInfo, bool streamResult) {
     /*
-    * @brief Takes the provided string, and attempts to DNS resolve it to a IPV4 address
-
-    * @param[in] The domain you want to fetch the IP address for
-    * @return None if the IPV4 address could not be loaded, otherwise a boost ip::address object.
+    * @brief A thread-safe way to record a port in the shard's results.
+    *
+    * The store keeps two bits of state per port and updates them with a single atomic
+    * compare and swap, so no lock is taken and deduplication is O(1). Shards own disjoint
+    * ports, so deduplicating within the shard is enough. New ports are also published to
+    * `outputSink` and `resultHandler` right away, unless the caller does so once their banner is in.
+    * Nothing is recorded during host discovery, as the full scan probes those ports again.
+    *
+    * @param[in] The shard the port was probed by
+    * @param[in] The index in `targets` of the target you want to update
+    * @param[in] PortInfo struct holding the port and the status
+    * @param[in] Whether to stream the port to `outputSink` now
+    * @return false if the port was already recorded
     */
-    boost::asio::io_context io_context;
-    boost::asio::ip::tcp::resolver resolver(io_context);
-    boost::system::error_code ec;
-
-    boost::asio::ip::basic_resolver_results<boost::asio::ip::tcp> endpoints = resolver.resolve(domain, "", ec);
-
-    if (ec) {
-        if (logger) {
-            logger->debug("Failed to resolve string '{}' to due error {}", domain, ec.to_string());
+    if (isDiscovering) {
+        return false;
+    }
+    // If we already have the port recorded for the target then return. The target is only
+    // built for a new port, as it copies the name of a host target.
+    if (!shard.results.record(targetIndex, portInfo)) {
+        if (logger->should_log(spdlog::level::debug)) {
+            logger->debug("[Scanner::updateDictionary] Port: {} on host: {} is already recorded", portInfo.port, targets.at(targetIndex).prettyName);
         }
-        return boost::none;
+        return false;
+    }
+
+    Target target = targets.at(targetIndex);
+    logger->debug("[Scanner::updateDictionary] Added port: {} to host: {} dictionary", portInfo.port, target.prettyName);
+    logger->info("Discovered {} port {}/tcp on {}", state_to_string(portInfo.status), portInfo.port, target.prettyName);
+    if (streamResult) {
+        publishResult(target, portInfo, getServiceNameForPort(portInfo.port));
     }
+    return true;
+}
 
-    for (const auto& entry : endpoints) {
-        boost::asio::ip::address addr = entry.endpoint().address();
-        if (addr.is_v4()) {
-            return addr;
+
+bool Scanner::grabBanner(ScanShard& shard, ProbeSlot& slot, PortInfo portInfo) {
+    /**
+     * @brief Identifies the service on a freshly connected open port.
+     *
+     * The banner is read on the same executor as the probes while the probe slot goes back to
+     * work, and the port is published once its service is known. The read counts as work of
+     * the shard, so a scan on an external executor doesn't complete before it. Only
+     * `maxBannerSessions` reads may run apart from a slot, as their sockets aren't covered by
+     * the connection budget; past that the slot does the read itself and is finished after it.
+     *
+     * @param shard The shard the port was probed by.
+     * @param slot The slot that connected; its socket is taken over.
+     * @param portInfo The open port.
+     * @return true if the slot is still in use and will be finished once the banner is in.
+     */
+    std::size_t targetIndex = slot.targetIndex;
+    bool isDetached = bannerSessions.fetch_add(1) < maxBannerSessions;
+    if (isDetached) {
+        shard.work.fetch_add(1);
+    }
+    else {
+        bannerSessions.fetch_sub(1);
+    }
+    ProbeSlot* heldSlot = isDetached ? nullptr : &slot;
+    bannerGrabber->grab(std::move(slot.socket), [this, &shard, targetIndex, portInfo, heldSlot](const std::string& service, const std::string& banner) {
+        Target target = targets.at(targetIndex);
+        if (!banner.empty()) {
+            logger->debug("[Scanner::grabBanner] Port: {} on host: {} sent: {}", portInfo.port, target.prettyName, banner);
         }
-        logger->info("Domain '{}' resolved to an IPv6 address '{}', but IPv6 support is currently disabled. Ignoring this address.", domain, addr.to_string());
+        if (!service.empty()) {
+            shard.results.recordService(targetIndex, portInfo.port, service);
+            logger->info("Identified {} on port {}/tcp of {}", service, portInfo.port, target.prettyName);
+        }
+        publishResult(target, portInfo, service.empty() ? getServiceNameForPort(portInfo.port) : std::string_view(service));
+        if (heldSlot) {
+            finishProbe(shard, *heldSlot);
+            return;
+        }
+        bannerSessions.fetch_sub(1);
+        releaseWork(shard);
+        });
+    return heldSlot != nullptr;
+}
+
+
+void Scanner::publishResult(const Target& target, PortInfo portInfo, std::string_view service) {
+    /**
+     * @brief Hands a newly recorded port to `outputSink` and `resultHandler`, whichever are set.
+     *
+     * Runs on the probe's executor, so with several threads both may be called concurrently.
+     */
+    if (outputSink) {
+        outputSink->write(target, portInfo, service);
+    }
+    if (resultHandler) {
+        resultHandler(target, portInfo, service);
     }
-    return boost::none;
 }
 
 
+std::string_view Scanner::serviceName(const ResultStore& store, std::size_t targetIndex, int port) const {
+    std::string_view service = store.serviceFor(targetIndex, port);
+    return service.empty() ? getServiceNameForPort(port) : service;
+}
+
 
-void Scanner::updateDictionary(Target target, PortInfo portInfo) {
+void Scanner::addTarget(const std::string& spec, std::vector<std::string>& domains) {
     /*
-    * @brief A thread-safe way to update the `scanResults` vector.
-    *
-    * Uses a mutex to ensure no other thread is writing to the scanResults before attempting 
-    * to read/write to it.
-    *
-    * @param[in] The target you want to update
-    * @param[in] PortInfo struct holding the port and the status
-    */
-    std::unique_lock<std::mutex> lock(portsMutex);
-    // Ensure there is an entry for the target's pretty name.
-    std::vector<PortInfo>& portVec = scanResults[target.prettyName];
+    @brief Adds a single target spec to `targets`.
 
-    bool alreadyExists = std::any_of(portVec.begin(), portVec.end(),
-        [port = portInfo.port](const PortInfo& info) { return info.port == port; });
+    IPv4 addresses, CIDR blocks and dash ranges are stored as ranges without expanding them.
+    Anything else is tried as an IPv6 address, and otherwise treated as a domain to resolve.
 
-    // If we already have the port recorded for the target then return.
-    if (alreadyExists) {
-        logger->debug("[Scanner::updateDictionary] Port: {} on host: {} is already recorded", portInfo.port, target.prettyName);
+    @param[in] spec The text from --target or a line of --input-file
+    @param[out] domains Collects the specs that have to be resolved
+    */
+    if (targets.addRange(spec)) {
         return;
     }
-
-    portVec.push_back({ portInfo.port, portInfo.status });
-    logger->debug("[Scanner::updateDictionary] Added port: {} to host: {} dictionary", portInfo.port, target.prettyName);
-    logger->info("Discovered {} port {}/tcp on {}", state_to_string(portInfo.status), portInfo.port, target.prettyName);
+    boost::system::error_code ec;
+    boost::asio::ip::address address = boost::asio::ip::make_address(spec, ec);
+    if (!ec) {
+        targets.addHost(Target(address));
+        return;
+    }
+    domains.push_back(spec);
 }
 
 
 void Scanner::loadTargets() {
     /*
-    @brief loads the targets passed with the `-t` option resolving any potential domains.
+    @brief loads the targets passed with the `-t` and `-i` options, and starts resolving any domains.
+
+    The input file is read one line at a time; blank lines and lines starting with '#' are skipped.
+    Domains are placed after every address, so the scan reaches them last and they have the
+    most time to resolve in the background. Probes for a name that hasn't resolved yet wait on
+    `resolver` without holding up the rest of the scan.
     */
+    std::vector<std::string> domains;
     std::stringstream ss(targetString);
     std::string line;
     while (std::getline(ss, line, ',')) {
-        try {
-            boost::asio::ip::address address = boost::asio::ip::address::from_string(line);
-            Target target(address);
-            targets.push_back(target);
-            scanResults[target.prettyName];
-        }
-        catch (const boost::system::system_error& e) {
-            boost::optional<boost::asio::ip::address> resolvedAddress = resolveDomainFromString(line);
-            if (resolvedAddress) {
-                // Use the original domain name as the pretty name.
-                Target target(*resolvedAddress, line);
-                targets.push_back(target);
-                scanResults[target.prettyName];
-            }
-            else {
-                if (logger) {
-                    logger->error("Invalid IPV4 address or invalid domain: '{}' ({})", line, e.what());
-                }
+        if (!line.empty()) {
+            addTarget(line, domains);
+        }
+    }
+    if (!inputFile.empty()) {
+        std::ifstream file(inputFile);
+        if (!file && logger) {
+            logger->error("Unable to open the input file '{}'", inputFile);
+        }
+        while (std::getline(file, line)) {
+            line.erase(0, line.find_first_not_of(" \t\r"));
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty() && line[0] != '#') {
+                addTarget(line, domains);
             }
         }
     }
+    firstDomain = targets.size();
+    for (const std::string& domain : domains) {
+        targets.addPendingHost(domain);
+    }
+    if (logger) {
+        logger->debug("[Scanner::loadTargets] Loaded {} targets, {} of them domains", targets.size(), domains.size());
+    }
+
+    resolver = std::make_unique<HostResolver>(targets, dnsConcurrency, logger);
+    if (!hostsFile.empty() && !resolver->loadHostsFile(hostsFile) && logger) {
+        logger->error("Unable to open the hosts file '{}'", hostsFile);
+    }
+    resolver->start();
+}
+
+
+RttEstimator& Scanner::rttFor(std::size_t targetIndex) {
+    /**
+     * @brief Fetches the round trip estimator of a target.
+     *
+     * Huge target spaces share a fixed amount of estimators between them, so memory use
+     * doesn't grow with the amount of targets.
+     *
+     * @param targetIndex The index in `targets` of the target.
+     * @return The estimator to read from and feed samples into.
+     */
+    return targetRtt[targetIndex % targetRtt.size()];
 }
 
 
-void Scanner::handleSocketError(
-    boost::asio::strand<boost::asio::io_context::executor_type> strand,
-    boost::system::error_code ec, int port,
-    Target target, int retries)
+void Scanner::handleSocketError(ScanShard& shard, ProbeSlot& slot, boost::system::error_code ec)
 {
     /**
     * @brief Handles socket errors during asynchronous connection attempts.
     *
     * Evaluates the error code returned from a socket operation. For resource exhaustion errors
-    * (boost::system::errc::resource_unavailable_try_again) with remaining retries, it schedules a
-    * retry after a delay. For other errors, it either updates the port status (filtered or closed)
-    * or logs the error message.
+    * (EAGAIN, ENOBUFS, EMFILE, ENFILE) the congestion window is shrunk and the probe is deferred to the retry
+    * pass, so the slot is free again right away. Without a retry pass left the probe is given
+    * up on. For other errors, it either updates the port status (filtered or closed) or logs the
+    * error message.
     *
-    * @param strand The Boost.Asio strand executor used for posting retry operations.
+    * @param shard The shard the probe belongs to.
+    * @param slot The probe slot the error came from.
     * @param ec The error code returned from the socket operation.
-    * @param port The port number being scanned.
-    * @param target The target being scanned.
-    * @param retries The remaining number of retry attempts.
     */
+    int port = slot.port;
 
-    if (ec.value() == boost::system::errc::resource_unavailable_try_again && retries > 0) {
-        const int& sleepTime = ((5 - retries) * 2);
-        if (logger) {
-            logger->debug("[Scanner::isOpen] Resource exhaustion on {}:{} - retrying in {} seconds ({} retries left)",
-                target.prettyName, port, sleepTime, retries);
-        }
-        auto retryTimer = std::make_shared<boost::asio::steady_timer>(ctx, std::chrono::seconds(sleepTime));
-        retryTimer->async_wait(boost::asio::bind_executor(strand,
-            [this, target, port, retries, retryTimer](const boost::system::error_code& ecRetry) {
-                if (!ecRetry) {
-                    isOpen(target, port, retries - 1);
-                }
-            }
-        ));
+    bool isExhausted = ec.value() == boost::system::errc::resource_unavailable_try_again || ec == boost::asio::error::no_buffer_space
+        || ec == boost::asio::error::no_descriptors || ec.value() == boost::system::errc::too_many_files_open_in_system;
+    if (isExhausted) {
+        recordResourceExhausted(shard);
+        if (!deferProbe(shard, slot.targetIndex, port, true) && logger && logger->should_log(spdlog::level::debug)) {
+            logger->debug("[Scanner::isOpen] Resource exhaustion on {}:{} with no retry pass left; giving up on it",
+                targets.at(slot.targetIndex).prettyName, port);
+        }
     }
     else if (ec == boost::asio::error::no_permission || ec.value() == 10013) {
         PortInfo portInfo = PortInfo(port, PortState::Filtered);
-        updateDictionary(target, portInfo);
+        updateDictionary(shard, slot.targetIndex, portInfo);
     }
     else if (ec == boost::asio::error::connection_refused) {
         logger->debug("In closed port branch: displayClosedPorts = {}, ec.value() = {}", displayClosedPorts, ec.value());
         if (displayClosedPorts) {
             PortInfo portInfo = PortInfo(port, PortState::Closed);
-            updateDictionary(target, portInfo);
+            updateDictionary(shard, slot.targetIndex, portInfo);
         }
     }
 
-    else if (logger && ec != boost::asio::error::connection_refused) {
+    else if (logger && logger->should_log(spdlog::level::debug)) {
         logger->debug("[Scanner::isOpen] Connection to {}:{} failed with error: {}",
-            target.prettyName, port, ec.message());
+            targets.at(slot.targetIndex).prettyName, port, ec.message());
     }
 }
 
 
-void Scanner::throttleConnectionIfNeeded(Target target, int port, int retries) {
+std::chrono::milliseconds Scanner::probeTimeout(std::size_t targetIndex) {
     /**
-     * @brief Throttles connection attempts if active connections exceed the allowed maximum.
+     * @brief Picks the connect deadline for a target.
      *
-     * Checks the current number of active connections. If this exceeds the maximum allowed,
-     * it schedules a delayed connection attempt using a timer to avoid overloading the system.
+     * Uses the target's own round trip estimates once it has answered a probe, and the initial
+     * timeout of the timing template until then. Other targets' round trips say nothing about
+     * a host further away, so one fast host nearby must not shorten the first probes to it.
      *
-     * @param target The target host to connect to.
-     * @param port The port number being scanned.
-     * @param retries The remaining number of retry attempts.
+     * @param targetIndex The index in `targets` of the target being probed.
+     * @return The deadline in milliseconds.
      */
-    if (activeConnections.fetch_add(1) >= maxConnections) {
-        activeConnections.fetch_sub(1);
-        if (logger) {
-            logger->debug("[Scanner::isOpen] Throttling connection to {}:{} (activeConnections: {})",
-                target.prettyName, port, activeConnections.load());
-        }
-        auto delayTimer = std::make_shared<boost::asio::steady_timer>(ctx, std::chrono::seconds(timeout));
-        delayTimer->async_wait([this, target, port, retries, delayTimer](const boost::system::error_code& ec) {
-            if (!ec) {
-                isOpen(target, port, retries);
-            }
-            });
+    if (liveHosts->contains(targetIndex)) {
+        return rttFor(targetIndex).timeout(timingTemplate);
+    }
+    return timingTemplate.initialTimeout;
+}
+
+
+void Scanner::recordResponse(ScanShard& shard, std::size_t targetIndex, std::chrono::microseconds rtt, PortState state) {
+    /**
+     * @brief Records the round trip time of a probe that was answered (open or refused).
+     *
+     * The answer marks the target as alive, which during host discovery also skips its
+     * remaining discovery probes.
+     *
+     * @param shard The shard that sent the probe.
+     * @param targetIndex The index in `targets` of the target that answered.
+     * @param rtt The time between starting the connect and it completing.
+     * @param state Open for an accepted connect or SYN-ACK, Closed for a refusal.
+     */
+    rttFor(targetIndex).addSample(rtt);
+    hostScheduler->onAnswer(targetIndex);
+    shard.congestionWindow.onResponse();
+    metrics->recordLatency(targetIndex, rtt);
+    (state == PortState::Open ? metrics->open : metrics->refused).fetch_add(1, std::memory_order_relaxed);
+    if (liveHosts->mark(targetIndex) && isDiscovering) {
+        logger->debug("[Scanner::recordResponse] Host {} is up", targets.at(targetIndex).prettyName);
+    }
+}
+
+
+void Scanner::recordTimeout(ScanShard& shard) {
+    /**
+     * @brief Records a probe that ran into its deadline without an answer.
+     *
+     * @param shard The shard that sent the probe.
+     */
+    metrics->timeouts.fetch_add(1, std::memory_order_relaxed);
+    if (shard.congestionWindow.onTimeout()) {
+        metrics->throttles.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+void Scanner::recordUnanswered(ScanShard& shard, std::size_t targetIndex, int port) {
+    /**
+     * @brief Handles a probe that ran into its deadline, for either engine.
+     *
+     * The probe is deferred to the next retry pass if there is one. Otherwise it is given up
+     * on: unrecorded like a closed port, except that a port a watch scan knows stopped answering
+     * and is most likely firewalled now, so it is recorded as filtered. Either way the timeout
+     * counts against the target's in-flight cap. A probe aborted by `cancel()` didn't time out
+     * and is dropped.
+     *
+     * @param shard The shard that sent the probe.
+     * @param targetIndex The index in `targets` of the target that didn't answer.
+     * @param port The port probed.
+     */
+    if (cancelled) {
+        return;
+    }
+    recordTimeout(shard);
+    hostScheduler->onTimeout(targetIndex);
+    if (deferProbe(shard, targetIndex, port, false)) {
         return;
     }
+    if (history && history->contains(targetIndex, port)) {
+        updateDictionary(shard, targetIndex, PortInfo(port, PortState::Filtered), false);
+    }
 }
 
-void Scanner::isOpen(Target target, int port, int retries) {
+
+bool Scanner::deferProbe(ScanShard& shard, std::size_t targetIndex, int port, bool isSendFailure) {
     /**
-     * @brief Attempts to determine if a given port on a target is open.
+     * @brief Puts a probe off to the next retry pass instead of trying it again straight away.
      *
-     * Applies connection throttling as necessary before asynchronously attempting a TCP
-     * connection to the specified port. Uses a timeout mechanism and handles the result by
-     * updating the scan results or invoking error handling.
+     * Nothing is deferred during host discovery or once the last pass is running. Timeouts on
+     * targets that never answer add up to most of a scan of a sparse range, so whenever the
+     * shard's list reaches `pruneAt` the timeouts of targets that haven't answered anything yet
+     * are dropped, and the limit doubles past what is left.
+     *
+     * @param shard The shard that sent the probe.
+     * @param targetIndex The index in `targets` of the target probed.
+     * @param port The port probed.
+     * @param isSendFailure True if the kernel failed to send the probe, false if it timed out.
+     * @return false if the probe has no retry pass left.
+     */
+    if (retryPassesLeft <= 0 || isDiscovering) {
+        return false;
+    }
+    metrics->deferred.fetch_add(1, std::memory_order_relaxed);
+    TargetPort probe{ targetIndex, static_cast<std::uint16_t>(port) };
+    std::lock_guard<std::mutex> lock(shard.retryMutex);
+    if (isSendFailure) {
+        shard.failed.push_back(probe);
+        return true;
+    }
+    shard.timedOut.push_back(probe);
+    if (shard.timedOut.size() >= shard.pruneAt) {
+        std::erase_if(shard.timedOut, [this](const TargetPort& deferred) {
+            return !liveHosts->contains(deferred.targetIndex);
+            });
+        shard.pruneAt = std::max(shard.pruneAt, shard.timedOut.size() * 2);
+    }
+    return true;
+}
+
+
+void Scanner::recordResourceExhausted(ScanShard& shard) {
+    /**
+     * @brief Records the kernel running out of sockets, ports or buffers for a probe.
      *
-     * @param target The target host to scan.
-     * @param port The port number to test.
-     * @param retries The allowed number of retry attempts if connection fails.
+     * @param shard The shard that sent the probe.
      */
-    throttleConnectionIfNeeded(target, port, retries);
+    if (shard.congestionWindow.onResourceExhausted()) {
+        metrics->throttles.fetch_add(1, std::memory_order_relaxed);
+    }
+}
 
-    boost::asio::strand strand = boost::asio::make_strand(ctx);
-    auto completed = std::make_shared<std::atomic_bool>(false);
-    auto socket = std::make_shared<boost::asio::ip::tcp::socket>(ctx);
-    auto timer = std::make_shared<boost::asio::steady_timer>(ctx);
-    boost::asio::ip::tcp::endpoint endpoint(target.address, port);
-    timer->expires_after(std::chrono::seconds(timeout));
 
-    socket->async_connect(endpoint, boost::asio::bind_executor(strand,
-        [this, target, port, socket, timer, retries, strand, completed](const boost::system::error_code& ec) {
-            if (!completed->exchange(true)) {
-                activeConnections.fetch_sub(1);
+void Scanner::isOpen(ScanShard& shard, ProbeSlot& slot) {
+    /**
+     * @brief Attempts to determine if a given port on a target is open.
+     *
+     * Must run on the slot's executor while holding a slot from the shard's limiter. Asynchronously attempts a
+     * TCP connection to the slot's target and port, uses the slot's timer as the deadline and
+     * handles the result by updating the scan results or invoking error handling. The deadline
+     * comes from the target's round trip estimates, and the outcome is fed back into them and the
+     * shard's congestion window. The slot's socket, timer and executor are reused, so nothing is
+     * allocated per probe. Probes for a domain that is still resolving wait for `resolver`,
+     * and probes for a domain that failed to resolve are dropped, as are discovery probes for a
+     * host that has already answered and every probe of a cancelled scan. With a rate cap the probe waits on the slot's timer until
+     * its send time comes up.
+     *
+     * @param shard The shard the slot belongs to.
+     * @param slot The probe slot holding the target index, port and remaining retries.
+     */
+    if (isDiscovered(slot.targetIndex) || cancelled) {
+        finishProbe(shard, slot);
+        return;
+    }
+    TargetSpace::HostState hostState = targets.stateAt(slot.targetIndex);
+    if (hostState == TargetSpace::HostState::Pending) {
+        resolver->whenResolved(slot.targetIndex, slot.executor, [this, &shard, &slot]() {
+            isOpen(shard, slot);
+            });
+        return;
+    }
+    if (hostState == TargetSpace::HostState::Failed) {
+        finishProbe(shard, slot);
+        return;
+    }
+
+    std::chrono::steady_clock::time_point sendAt = reserveSend(slot.targetIndex);
+    if (sendAt > std::chrono::steady_clock::now()) {
+        slot.timer.expires_at(sendAt);
+        slot.timer.async_wait([this, &shard, &slot](const boost::system::error_code& ec) {
+            if (!ec && !cancelled) {
+                connectProbe(shard, slot);
+            }
+            else {
+                finishProbe(shard, slot);
             }
+            });
+        return;
+    }
+    connectProbe(shard, slot);
+}
+
+
+void Scanner::connectProbe(ScanShard& shard, ProbeSlot& slot) {
+    /**
+     * @brief Connects to the slot's target and port and handles the outcome.
+     *
+     * Must run on the slot's executor once `isOpen()` has let the probe through. With
+     * `--source-address` the socket is bound to the slot's source address first. An open port's
+     * connection is reset rather than closed, so it doesn't hold its local port in TIME_WAIT.
+     *
+     * @param shard The shard the slot belongs to.
+     * @param slot The probe slot holding the target index, port and remaining retries.
+     */
+    slot.generation++;
+    slot.completed = false;
+    boost::asio::ip::tcp::endpoint endpoint(targets.addressAt(slot.targetIndex), slot.port);
+    if (const boost::asio::ip::address* source = sourceFor(slot.id, endpoint.address())) {
+        boost::system::error_code ec = bindSource(slot.socket, endpoint.protocol(), *source);
+        if (ec && logger) {
+            logger->debug("[Scanner::connectProbe] Unable to bind to {}: {}", source->to_string(), ec.message());
+        }
+    }
+    slot.timer.expires_after(probeTimeout(slot.targetIndex));
+    slot.sentAt = std::chrono::steady_clock::now();
+    metrics->onSent();
+
+    slot.socket.async_connect(endpoint,
+        [this, &shard, &slot](const boost::system::error_code& ec) {
+            slot.completed = true;
+            metrics->onCompleted();
             boost::system::error_code ignore;
-            timer->cancel(ignore);
-            bool isPortOpen = socket->is_open();
-            socket->close();
+            slot.timer.cancel(ignore);
+            bool isPortOpen = slot.socket.is_open();
+            auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - slot.sentAt);
             if (!ec && isPortOpen) {
-                PortInfo portInfo = PortInfo(port, PortState::Open);
-                updateDictionary(target, portInfo);
+                recordResponse(shard, slot.targetIndex, rtt, PortState::Open);
+                PortInfo portInfo = PortInfo(slot.port, PortState::Open);
+                // The banner stage takes the connection over; the slot gets a fresh socket on its next connect.
+                if (updateDictionary(shard, slot.targetIndex, portInfo, !bannerGrabber) && bannerGrabber && grabBanner(shard, slot, portInfo)) {
+                    return;
+                }
+                closeAbortively(slot.socket);
             }
             else {
-                handleSocketError(strand, ec, port, target, retries);
+                slot.socket.close(ignore);
+                if (ec == boost::asio::error::connection_refused) {
+                    recordResponse(shard, slot.targetIndex, rtt, PortState::Closed);
+                }
+                else if (ec == boost::asio::error::operation_aborted) {
+                    recordUnanswered(shard, slot.targetIndex, slot.port);
+                }
+                handleSocketError(shard, slot, ec);
             }
+            finishProbe(shard, slot);
         }
-    ));
-    timer->async_wait([socket, completed](const boost::system::error_code& ec) {
-        if (!ec && !completed->load()) {
-            socket->cancel();
+    );
+    slot.timer.async_wait([&slot, generation = slot.generation](const boost::system::error_code& ec) {
+        if (!ec && slot.generation == generation && !slot.completed) {
+            boost::system::error_code ignore;
+            slot.socket.cancel(ignore);
         }
         });
 }
 
 
-void Scanner::displayResults() {
+bool Scanner::isDiscovered(std::size_t targetIndex) const {
+    return isDiscovering && liveHosts->contains(targetIndex);
+}
+
+
+std::chrono::steady_clock::time_point Scanner::reserveSend(std::size_t targetIndex) {
     /**
-     * @brief Displays the scan results for all targets to the console.
+     * @brief Claims a send under the global and the per target rate cap.
+     *
+     * Both buckets are charged right away, so a probe that waits for one cap also uses up its
+     * turn in the other; that keeps the load steady at the cost of a little throughput when
+     * both caps are close.
      *
-     * Iterates through the stored scan results and prints a formatted report that includes
-     * the port number, its state, and a guessed service name.
+     * @param targetIndex The index in `targets` of the target the probe goes to.
+     * @return The time the probe may be sent, `now` when no cap applies.
      */
-    for (const auto& [targetName, ports] : scanResults) {
-        std::cout << "BPS scan report for " << targetName << "\n";
-        if (ports.empty()) {
-            std::cout << "No open ports found.\n\n";
-            continue;
+    std::chrono::steady_clock::time_point sendAt = globalRate->reserve();
+    return std::max(sendAt, hostRate->reserve(targetIndex));
+}
+
+
+void Scanner::finishProbe(ScanShard& shard, ProbeSlot& slot) {
+    /**
+     * @brief Recycles a finished probe slot and frees its connection slot for the next probe.
+     *
+     * If a probe waiting on the same HostScheduler bucket is parked, the bucket has just made
+     * room for it, so it takes over the slot along with its connection slot and its piece of the
+     * shard's work. A launcher waiting for room among the parked probes is started again.
+     *
+     * @param shard The shard the slot belongs to.
+     * @param slot The slot whose probe has completed.
+     */
+    shard.probeSource.finish(slot.id);
+    hostScheduler->release(slot.targetIndex);
+    if (!cancelled && shard.probeSource.parkedCount() > 0 && hostScheduler->tryAcquire(slot.targetIndex)) {
+        std::optional<Probe> probe = shard.probeSource.unpark(slot.id, hostScheduler->keyFor(slot.targetIndex));
+        if (probe) {
+            slot.targetIndex = probe->targetIndex;
+            slot.port = probe->port;
+            boost::asio::post(slot.executor, [this, &shard, &slot]() {
+                isOpen(shard, slot);
+                });
+            wakeLauncher(shard);
+            return;
         }
-        std::vector<PortInfo> sortedPorts = ports;
-        std::sort(sortedPorts.begin(), sortedPorts.end(), [](const PortInfo& a, const PortInfo& b) {
-            return a.port < b.port;
+        hostScheduler->release(slot.targetIndex);
+    }
+    shard.probePool.release(&slot);
+    shard.limiter.release();
+    wakeLauncher(shard);
+    releaseWork(shard);
+}
+
+
+void Scanner::wakeLauncher(ScanShard& shard) {
+    /**
+     * @brief Starts the shard's idle launcher again once the parked probes leave it room.
+     *
+     * A cancelled scan wakes it too, so it can give up its piece of the work.
+     *
+     * @param shard The shard whose launcher may be waiting.
+     */
+    if (!shard.isLauncherIdle.load() || (!cancelled && shard.probeSource.parkedCount() >= parkLimit(shard))) {
+        return;
+    }
+    if (shard.isLauncherIdle.exchange(false)) {
+        boost::asio::post(shard.executor, [this, &shard]() {
+            launchNextProbe(shard);
             });
+    }
+}
+
+
+std::size_t Scanner::parkLimit(const ScanShard& shard) const {
+    return std::max(MIN_PARKED, PARKED_PER_SLOT * static_cast<std::size_t>(shard.timingTemplate.maxConnections));
+}
+
+
+void Scanner::releaseWork(ScanShard& shard) {
+    /**
+     * @brief Marks a piece of the shard's work as done and reports the shard finished after the last one.
+     *
+     * @param shard The shard the work belonged to.
+     */
+    if (shard.work.fetch_sub(1) == 1 && shard.onFinished) {
+        shard.onFinished();
+    }
+}
+
+
+void Scanner::displayResults() {
+    /**
+     * @brief Displays the scan results for all targets to the console.
+     *
+     * Iterates through the targets that reported a port, in the order they were given, and
+     * prints a formatted report from `results` that includes the port number, its state, and a
+     * guessed service name. The silent targets are summarised in a single line, so scanning a
+     * large range doesn't print a report for every address in it.
+     */
+    std::vector<std::size_t> reportedTargets = results->reportedTargets();
+    for (std::size_t targetIndex : reportedTargets) {
+        std::cout << "BPS scan report for " << targets.at(targetIndex).prettyName << "\n";
+        std::vector<PortInfo> sortedPorts = results->portsFor(targetIndex);
 
         std::cout << std::left
             << std::setw(10) << "PORT"
@@ -267,11 +628,15 @@ void Scanner::displayResults() {
             std::cout << std::left
                 << std::setw(10) << portStr
                 << std::setw(12) << state_to_string(info.status)
-                << std::setw(26) << getServiceNameForPort(info.port)
+                << std::setw(26) << serviceName(*results, targetIndex, info.port)
                 << "\n";
         }
         std::cout << "\n";
     }
+    std::size_t silentTargets = targets.size() - reportedTargets.size();
+    if (silentTargets > 0) {
+        std::cout << "No open ports found on " << silentTargets << " of " << targets.size() << " host(s).\n\n";
+    }
 }
 
 
@@ -290,135 +655,1233 @@ float Scanner::getElapsed() const {
 }
 
 
-void Scanner::scan() {
+void Scanner::launchNextProbe(ScanShard& shard) {
     /**
-     * @brief Initiates the scanning process.
+     * @brief Waits for a connection slot, then pulls the shard's next (target, port) pair and probes it.
+     *
+     * Only one of these is ever waiting on the shard's limiter, so the shard holds at most its
+     * share of `maxConnections` probes instead of its whole slice of the target x port space.
+     * It stops once the slice is exhausted or the scan is cancelled.
+     * Each probe runs in a recycled slot from the shard's pool. Once a probe has been started the
+     * next call is posted rather than made directly to keep the stack flat while slots are free.
+     * Probes of a target at its in-flight cap are skipped for now, see `nextProbe()`. With the
+     * park list full the launcher goes idle, keeping its piece of the work, until a finishing
+     * probe takes a parked one over and wakes it.
      *
-     * Sets up the asynchronous I/O context and spawns a pool of threads to run the scanning tasks.
-     * Posts connection tasks for each target and port in the specified range, manages the work guard,
-     * and waits for all threads to finish before proceeding.
+     * @param shard The shard to launch the next probe on.
      */
-    auto workGuard = boost::asio::make_work_guard(ctx);
-    // gets thread hint with a mininum value of 1
-    unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
-    if (logger) {
-        logger->debug("[Scanner::scan] Using {} threads to run the ctx context", threadCount);
+    shard.limiter.acquire([this, &shard]() {
+        ProbeSlot* slot = shard.probePool.acquire();
+        std::optional<Probe> probe = cancelled ? std::nullopt : nextProbe(shard, *slot);
+        if (!probe) {
+            shard.probePool.release(slot);
+            shard.limiter.release();
+            if (!cancelled && shard.probeSource.parkedCount() >= parkLimit(shard)) {
+                shard.isLauncherIdle.store(true);
+                // A probe may have been taken over before the flag was set.
+                wakeLauncher(shard);
+                return;
+            }
+            // The launcher's own share of the shard's work.
+            releaseWork(shard);
+            return;
+        }
+        slot->targetIndex = probe->targetIndex;
+        slot->port = probe->port;
+        shard.work.fetch_add(1);
+        boost::asio::post(slot->executor, [this, &shard, slot]() {
+            isOpen(shard, *slot);
+            });
+        boost::asio::post(shard.executor, [this, &shard]() {
+            launchNextProbe(shard);
+            });
+        });
+}
+
+
+std::optional<Probe> Scanner::nextProbe(ScanShard& shard, ProbeSlot& slot) {
+    /**
+     * @brief Pulls probes until one's target is below its in-flight cap and hands it to `slot`.
+     *
+     * The probes of targets at their cap are parked under their HostScheduler bucket, to be
+     * picked up by the next probe of that bucket that finishes. A cap is never exceeded: once
+     * `parkLimit()` probes are parked nothing more is pulled, and the parked probes left at the
+     * end of the walk only run as their targets make room, so the parked probes stay bounded
+     * and a slow host never holds more than its share.
+     *
+     * @param shard The shard to take the probe from.
+     * @param slot The slot that will run the probe.
+     * @return The probe now held by `slot`, or std::nullopt if the walk is done or the park list is full.
+     */
+    while (shard.probeSource.parkedCount() < parkLimit(shard)) {
+        std::optional<Probe> probe = shard.probeSource.next(slot.id);
+        if (!probe) {
+            return std::nullopt;
+        }
+        if (hostScheduler->tryAcquire(probe->targetIndex)) {
+            return probe;
+        }
+        std::size_t key = hostScheduler->keyFor(probe->targetIndex);
+        shard.probeSource.park(slot.id, *probe, key);
+        metrics->parked.fetch_add(1, std::memory_order_relaxed);
+        // The bucket's last probe may have finished before the park, with nothing to take over then.
+        if (hostScheduler->tryAcquire(probe->targetIndex)) {
+            std::optional<Probe> parked = shard.probeSource.unpark(slot.id, key);
+            if (parked) {
+                return parked;
+            }
+            hostScheduler->release(probe->targetIndex);
+        }
     }
-    std::vector<std::thread> threads;
-    for (unsigned int i = 0; i < threadCount; ++i) {
-        threads.emplace_back([this]() { ctx.run(); });
+    return std::nullopt;
+}
+
+
+int Scanner::createShards(std::size_t shardCount, unsigned int threads, const std::vector<std::uint16_t>& shardPorts,
+    const std::vector<std::size_t>* targetIndexes, std::size_t budgetShare) {
+    /**
+     * @brief Splits `shardPorts` on the given targets into `shardCount` shards.
+     *
+     * A single shard is run by every thread, with a strand per probe slot. Otherwise every
+     * thread gets a shard of its own and an even share of the connection budget.
+     *
+     * @param shardCount The amount of shards to create.
+     * @param threads The amount of threads that will run them.
+     * @param shardPorts The ports probed on every target; must outlive the shards.
+     * @param targetIndexes The targets to probe, or nullptr for every target.
+     * @param budgetShare Divides the connection budget, e.g. to run a retry pass more gently.
+     * @return The amount of threads running each shard.
+     *
+     * During a watch round or a retry pass between full sweeps the shards split `roundProbes` instead.
+     */
+    int threadsPerShard = shardCount > 1 ? 1 : static_cast<int>(threads);
+    TimingTemplate shardTemplate = timingTemplate.share(shardCount * budgetShare);
+    // With --shard the space is cut into a slice per shard of every process, and this process
+    // takes its consecutive run of them. A target or pair list was already picked for this process.
+    bool isPicked = targetIndexes || roundProbes;
+    std::size_t processCount = isPicked ? 1 : processShardCount;
+    std::size_t firstSlice = isPicked ? 0 : processShard * shardCount;
+    // Domains are walked after the addresses of every shard, giving them the most time to resolve.
+    std::size_t lateTargets = 0;
+    if (!roundProbes) {
+        lateTargets = targetIndexes
+            ? static_cast<std::size_t>(targetIndexes->end() - std::lower_bound(targetIndexes->begin(), targetIndexes->end(), firstDomain))
+            : targets.size() - firstDomain;
     }
-    for (Target& target : targets) {
-        for (int port = startPort; port <= endPort; ++port) {
-            ctx.post([this, target, port]() {
-                isOpen(target, port, 3);
-                });
-        }
+    for (std::size_t i = 0; i < shardCount; ++i) {
+        shards.push_back(std::make_unique<ScanShard>(firstSlice + i, shardCount * processCount, targets.size(), shardPorts, shardTemplate,
+            threadsPerShard, targetIndexes, orderSeed(), roundProbes, asyncExecutor, lateTargets));
     }
-    workGuard.reset();
     if (logger) {
-        logger->debug("[Scanner::scan] workGuard has been released");
+        logger->debug("[Scanner::createShards] Running {} shard(s) with {} thread(s) and up to {} connections each",
+            shardCount, threadsPerShard, shardTemplate.maxConnections);
+    }
+    return threadsPerShard;
+}
+
+
+void Scanner::runShardThreads(int threadsPerShard) {
+    /**
+     * @brief Starts every shard on its own threads and waits until they run out of probes.
+     *
+     * @param threadsPerShard The amount of threads running each shard's io_context.
+     */
+    std::vector<std::thread> threadPool;
+    for (std::unique_ptr<ScanShard>& shard : shards) {
+        ScanShard* current = shard.get();
+        current->work.store(1);
+        boost::asio::post(current->ctx, [this, current]() {
+            launchNextProbe(*current);
+            });
+        for (int i = 0; i < threadsPerShard; ++i) {
+            threadPool.emplace_back([current]() { current->ctx.run(); });
+        }
     }
     int i = 1;
-    for (std::thread& thread : threads) {
+    for (std::thread& thread : threadPool) {
         thread.join();
         if (logger) {
-            logger->debug("[Scanner::scan] thread {} has joined", i);
+            logger->debug("[Scanner::runShardThreads] thread {} has joined", i);
         }
         i++;
     }
 }
 
-void Scanner::createLogger() {
+
+void Scanner::runShards(unsigned int threads) {
     /**
-     * @brief Creates and configures the logger instance.
+     * @brief Splits the scan into shards and runs them until every probe has finished.
      *
-     * Retrieves an existing logger or creates a new one if necessary. Sets the logging level and
-     * formatting based on `isDebugMode` and `isVerboseMode`
+     * By default a single shard is run by every thread, with a strand per probe slot. With
+     * `--sharded` every thread gets a shard of its own: its own io_context, its own block
+     * of the targets with every port and an even share of the connection budget. Those shards
+     * share nothing but the per-target round trip estimates, so completions never contend
+     * across cores and no strands are needed. After host discovery only `liveTargets` are scanned.
+     *
+     * @param threads The amount of threads to run.
      */
-    logger = spdlog::get("bps");
-    if (!logger) {
-        logger = spdlog::stdout_color_mt("shared_logger");
-    }
-    if (isVerboseMode) {
-        logger->set_level(spdlog::level::info);
-    }
-    else if (isDebugMode) {
-        logger->set_level(spdlog::level::debug);
-        logger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
-        logger->debug("[Scanner::createLogger] Debug logging enabled.");
-    }
-    else {
-        logger->set_level(spdlog::level::warn);
+    std::size_t shardCount = isShardedMode ? threads : 1;
+    if (resumed) {
+        // A resumed scan has to be split exactly like the run that saved the checkpoint.
+        shardCount = resumed->cursors.size();
     }
+    int threadsPerShard = createShards(shardCount, threads, ports, isDiscoveryMode ? &liveTargets : nullptr);
+    applyCheckpoint();
+    std::thread checkpointer = startCheckpoints();
+    runShardThreads(threadsPerShard);
+    stopCheckpoints(checkpointer);
 }
 
-void Scanner::loadTimingTemplate() {
+
+void Scanner::discoverHosts(unsigned int threads) {
     /**
-     * @brief Loads the timing template to configure scanning performance parameters.
+     * @brief Finds the targets worth a full scan.
      *
-     * Sets the maximum allowed connections and the connection timeout based on a timing template.
-     * Logs warnings if a high-performance (and potentially error-prone) timing template is selected.
+     * Probes `discoveryPorts` on every target at once, with the same engine, timing and rate
+     * caps as the full scan. Any answer, open or refused, marks the host as up and skips its
+     * remaining discovery probes, so live hosts cost a single round trip and only dead ones
+     * wait out every deadline. A resumed scan reuses the hosts found by the run it continues.
+     * A scan split with --shard splits the targets instead of the target x port space, so each
+     * host is discovered and then scanned by exactly one process.
+     *
+     * @param threads The amount of threads to run.
      */
-    switch (timing)
+    if (resumed && resumed->liveTargets) {
+        liveTargets = *resumed->liveTargets;
+        logger->info("Resuming with the {} live host(s) found by host discovery", liveTargets.size());
+        return;
+    }
+    const std::vector<std::size_t>* discoveryTargets = beginDiscovery();
+    bool finished = false;
+    if (scanMode == "syn") {
+        createShards(1, 1, discoveryPorts, discoveryTargets);
+        SynScanner synScanner(*this, *shards.front());
+        finished = synScanner.run();
+        shards.clear();
+        if (!finished) {
+            logger->warn("Falling back to a connect scan");
+            scanMode = "connect";
+        }
+    }
+    if (!finished) {
+        runShardThreads(createShards(isShardedMode ? threads : 1, threads, discoveryPorts, discoveryTargets));
+        shards.clear();
+    }
+    endDiscovery();
+}
+
+
+std::vector<TargetPort> Scanner::collectDeferred() {
+    /**
+     * @brief Takes the deferred probes out of every shard for the next retry pass.
+     *
+     * A target that never answered is most likely down or behind a firewall that drops
+     * everything, and each of its probes already waited out the initial timeout, so its
+     * timeouts aren't worth another deadline. The probes a resumed checkpoint had deferred
+     * join the first pass. The probes are ordered by port so a pass spreads its load over
+     * every host instead of working through one at a time.
+     *
+     * @return The probes to retry.
+     */
+    std::vector<TargetPort> pending;
+    if (resumed) {
+        std::copy_if(resumed->deferred.begin(), resumed->deferred.end(), std::back_inserter(pending), [this](const TargetPort& probe) {
+            return probe.targetIndex < targets.size();
+            });
+        resumed->deferred.clear();
+    }
+    for (std::unique_ptr<ScanShard>& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->retryMutex);
+        for (const TargetPort& probe : shard->timedOut) {
+            if (liveHosts->contains(probe.targetIndex)) {
+                pending.push_back(probe);
+            }
+        }
+        pending.insert(pending.end(), shard->failed.begin(), shard->failed.end());
+        shard->timedOut.clear();
+        shard->failed.clear();
+    }
+    std::sort(pending.begin(), pending.end(), [](const TargetPort& a, const TargetPort& b) {
+        return std::tie(a.port, a.targetIndex) < std::tie(b.port, b.targetIndex);
+        });
+    return pending;
+}
+
+
+void Scanner::retryDeferred(unsigned int threads) {
+    /**
+     * @brief Probes the deferred probes again once the main pass is done.
+     *
+     * A dropped SYN or an overloaded host no longer hides an open port for good, and a busy
+     * host no longer holds up the main pass with retries of its own. Each pass runs on a
+     * quarter of the connection budget, with the same engine as the main pass. Every retried
+     * target has answered before, so its deadline comes from its own round trip estimate
+     * rather than the initial timeout. What times out again is deferred to the next pass, and
+     * after `retryPasses` passes it is given up on.
+     *
+     * @param threads The amount of threads to run.
+     */
+    const std::vector<TargetPort>* scanProbes = roundProbes;
+    for (int pass = 1; retryPassesLeft > 0 && !cancelled; ++pass) {
+        retryProbes = collectDeferred();
+        if (retryProbes.empty()) {
+            break;
+        }
+        retryPassesLeft--;
+        logger->info("Retry pass {}: probing {} port(s) that timed out or failed to send again", pass, retryProbes.size());
+        mergeShardResults();
+        shards.clear();
+        roundProbes = &retryProbes;
+        bool finished = false;
+        if (scanMode == "syn") {
+            createShards(1, 1, ports, nullptr, RETRY_BUDGET_SHARE);
+            SynScanner synScanner(*this, *shards.front());
+            finished = synScanner.run();
+        }
+        if (!finished) {
+            shards.clear();
+            runShardThreads(createShards(isShardedMode ? threads : 1, threads, ports, nullptr, RETRY_BUDGET_SHARE));
+        }
+    }
+    retryPassesLeft = 0;
+    roundProbes = scanProbes;
+}
+
+
+void Scanner::retryDeferredAsync(std::function<void()> then) {
+    /**
+     * @brief Runs the retry passes of `retryDeferred()` on `asyncExecutor`, one after the other.
+     *
+     * The shards of earlier passes are kept, like in `runPhaseAsync()`, and merged at the end.
+     *
+     * @param then Called once the last pass has finished, or right away if nothing is left to retry.
+     */
+    if (retryPassesLeft > 0 && !cancelled) {
+        retryProbes = collectDeferred();
+    }
+    if (retryPassesLeft <= 0 || cancelled || retryProbes.empty()) {
+        retryPassesLeft = 0;
+        roundProbes = nullptr;
+        then();
+        return;
+    }
+    retryPassesLeft--;
+    logger->info("Retry pass {}: probing {} port(s) that timed out or failed to send again", retryPasses - retryPassesLeft, retryProbes.size());
+    roundProbes = &retryProbes;
+    runPhaseAsync(ports, nullptr, [this, then]() {
+        retryDeferredAsync(then);
+        }, RETRY_BUDGET_SHARE);
+}
+
+
+const std::vector<std::size_t>* Scanner::beginDiscovery() {
+    /**
+     * @brief Puts the probe paths in discovery mode.
+     *
+     * @return The targets of this process when the scan is split with --shard, otherwise nullptr.
+     */
+    isDiscovering = true;
+    processTargets.clear();
+    if (processShardCount <= 1) {
+        return nullptr;
+    }
+    std::size_t last = targets.size() * (processShard + 1) / processShardCount;
+    for (std::size_t i = targets.size() * processShard / processShardCount; i < last; ++i) {
+        processTargets.push_back(i);
+    }
+    return &processTargets;
+}
+
+
+void Scanner::endDiscovery() {
+    isDiscovering = false;
+    liveTargets = liveHosts->collect();
+    logger->info("Host discovery found {} of {} host(s) up", liveTargets.size(), targets.size());
+}
+
+
+void Scanner::mergeShardResults() {
+    /**
+     * @brief Folds the results of every shard into `results` once they have all finished.
+     */
+    for (std::unique_ptr<ScanShard>& shard : shards) {
+        results->merge(shard->results);
+    }
+}
+
+
+std::uint64_t Scanner::scanFingerprint(bool includeShard) const {
+    /**
+     * @brief Hashes what decides the probe order (targets, ports and how they are walked) with FNV-1a.
+     *
+     * @param includeShard Also hash which slice of a --shard scan this process runs.
+     * @return The fingerprint stored in checkpoints.
+     */
+    std::uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const void* data, std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    std::uint64_t targetCount = targets.size();
+    mix(&targetCount, sizeof(targetCount));
+    mix(targetString.data(), targetString.size());
+    mix(inputFile.data(), inputFile.size());
+    mix(ports.data(), ports.size() * sizeof(std::uint16_t));
+    if (isRandomOrder) {
+        std::uint8_t randomOrder = 1;
+        mix(&randomOrder, sizeof(randomOrder));
+    }
+    if (includeShard && processShardCount > 1) {
+        std::uint64_t shard[2] = { processShard, processShardCount };
+        mix(shard, sizeof(shard));
+    }
+    if (isDiscoveryMode) {
+        mix(discoveryPorts.data(), discoveryPorts.size() * sizeof(std::uint16_t));
+    }
+    return hash;
+}
+
+
+std::optional<std::uint64_t> Scanner::orderSeed() const {
+    if (!isRandomOrder) {
+        return std::nullopt;
+    }
+    return seed;
+}
+
+
+void Scanner::loadSeed() {
+    /**
+     * @brief Settles the seed of a shuffled scan before any shard is created.
+     *
+     * The seed is logged so a scan with a random seed can be repeated with `--seed`. The
+     * fingerprint covers whether the order is shuffled but not the seed, so a resumed scan
+     * always continues in the order of the checkpoint. The processes of a --shard scan have to
+     * shuffle alike, so without a seed they all derive it from the scan's targets and ports.
+     */
+    if (!isRandomOrder) {
+        return;
+    }
+    if (resumed) {
+        if (seed != 0 && seed != resumed->seed) {
+            logger->debug("[Scanner::loadSeed] Ignoring seed {} in favour of the checkpoint's seed {}", seed, resumed->seed);
+        }
+        seed = resumed->seed;
+    }
+    if (seed == 0 && processShardCount > 1) {
+        seed = scanFingerprint(false);
+    }
+    std::random_device device;
+    while (seed == 0) {
+        seed = (static_cast<std::uint64_t>(device()) << 32) | device();
+    }
+    logger->info("Shuffling the probe order with seed {}", seed);
+}
+
+
+void Scanner::loadCheckpoint() {
+    /**
+     * @brief Loads the checkpoint given with `--resume`, if any.
+     *
+     * Its results are recorded in `results` straight away. A checkpoint from a scan with
+     * other targets or ports is rejected and the scan starts from the beginning.
+     */
+    if (resumeFile.empty()) {
+        return;
+    }
+    resumed = Checkpoint::load(resumeFile);
+    if (!resumed) {
+        logger->error("Unable to read the checkpoint '{}'; starting from the beginning", resumeFile);
+        return;
+    }
+    if (resumed->fingerprint != scanFingerprint()) {
+        logger->error("The checkpoint '{}' belongs to a scan with different targets or ports; starting from the beginning", resumeFile);
+        resumed.reset();
+        return;
+    }
+    for (const auto& [targetIndex, portInfo] : resumed->results) {
+        if (targetIndex < targets.size()) {
+            results->record(targetIndex, portInfo);
+        }
+    }
+    logger->info("Resuming from '{}' with {} ports already recorded", resumeFile, resumed->results.size());
+}
+
+
+void Scanner::applyCheckpoint() {
+    /**
+     * @brief Moves every shard's probe source past the work the resumed checkpoint finished.
+     */
+    if (!resumed) {
+        return;
+    }
+    if (resumed->cursors.size() != shards.size()) {
+        logger->warn("The checkpoint was saved with {} shard(s) but this scan runs {}; rescanning everything",
+            resumed->cursors.size(), shards.size());
+        return;
+    }
+    for (std::size_t i = 0; i < shards.size(); ++i) {
+        shards[i]->probeSource.resumeAt(resumed->cursors[i]);
+    }
+}
+
+
+void Scanner::saveCheckpoint() {
+    /**
+     * @brief Writes the progress of every shard and the results found so far to `checkpointFile`.
+     *
+     * The cursors are read before the results and the deferred probes, so every probe below a
+     * cursor has its result or its retry in the snapshot. Timeouts on targets that never
+     * answered are left out, as the retry pass would drop them anyway.
+     */
+    Checkpoint checkpoint;
+    checkpoint.fingerprint = scanFingerprint();
+    checkpoint.seed = isRandomOrder ? seed : 0;
+    if (isDiscoveryMode) {
+        checkpoint.liveTargets = liveTargets;
+    }
+    for (std::unique_ptr<ScanShard>& shard : shards) {
+        checkpoint.cursors.push_back(shard->probeSource.finishedBelow());
+    }
+    for (std::unique_ptr<ScanShard>& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->retryMutex);
+        std::copy_if(shard->timedOut.begin(), shard->timedOut.end(), std::back_inserter(checkpoint.deferred), [this](const TargetPort& probe) {
+            return liveHosts->contains(probe.targetIndex);
+            });
+        checkpoint.deferred.insert(checkpoint.deferred.end(), shard->failed.begin(), shard->failed.end());
+    }
+    auto collect = [&checkpoint](const ResultStore& store) {
+        for (std::size_t targetIndex : store.reportedTargets()) {
+            for (const PortInfo& portInfo : store.portsFor(targetIndex)) {
+                checkpoint.results.push_back({ targetIndex, portInfo });
+            }
+        }
+    };
+    collect(*results);
+    for (std::unique_ptr<ScanShard>& shard : shards) {
+        collect(shard->results);
+    }
+    if (!checkpoint.save(checkpointFile)) {
+        logger->error("Unable to write the checkpoint '{}'", checkpointFile);
+        return;
+    }
+    logger->debug("[Scanner::saveCheckpoint] Saved {} results to {}", checkpoint.results.size(), checkpointFile);
+}
+
+
+void Scanner::runCheckpoints() {
+    std::unique_lock<std::mutex> lock(checkpointMutex);
+    while (!checkpointWake.wait_for(lock, std::chrono::seconds(checkpointInterval), [this]() { return scanFinished; })) {
+        lock.unlock();
+        saveCheckpoint();
+        lock.lock();
+    }
+}
+
+
+std::thread Scanner::startCheckpoints() {
+    /**
+     * @brief Starts saving checkpoints in the background; the shards must already exist.
+     *
+     * @return The checkpoint thread, or an empty thread when checkpoints are disabled.
+     */
+    if (checkpointFile.empty()) {
+        return std::thread();
+    }
+    return std::thread([this]() { runCheckpoints(); });
+}
+
+
+void Scanner::stopCheckpoints(std::thread& checkpointer) {
+    /**
+     * @brief Stops the checkpoint thread and saves the finished scan one last time.
+     *
+     * @param checkpointer The thread returned by `startCheckpoints()`.
+     */
+    if (!checkpointer.joinable()) {
+        return;
+    }
     {
-    // Snail speed..... (5 years later...)
-    case 0:
-        logger->warn("Using `-T 0` this will be extremely slow!!!!");
-        maxConnections = 5;
-        timeout = 8;
-        break;
-    case 1:
-        maxConnections = 100;
-        timeout = 7;
-        break;
-    case 2:
-        maxConnections = 1000;
-        timeout = 6;
-        break;
-
-    // Consistent, and fast results.
-    case 3:
-        maxConnections = 2000;
-        timeout = 8;
-        break;
-    case 4:
-        maxConnections = 3000;
-        timeout = 3;
-        break;
-    case 5:
-        maxConnections = 4000;
-        timeout = 2;
-        break;
-    // Racecar, probably will display False positives
-    case 6:
-        maxConnections = 5000;
-        timeout = 2;
-        break;
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        scanFinished = true;
+    }
+    checkpointWake.notify_all();
+    checkpointer.join();
+    saveCheckpoint();
+}
+
+
+void Scanner::runStatus() {
+    /**
+     * @brief Prints a status line to stderr every `statsInterval` seconds.
+     *
+     * The probe rate covers the last interval only, so stalls show up right away. An in flight
+     * count well below `maxConnections` together with retries or throttles means the kernel is
+     * running out of sockets, not the network out of capacity.
+     */
+    std::uint64_t lastSent = 0;
+    auto lastTime = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(statusMutex);
+    while (!statusWake.wait_for(lock, std::chrono::seconds(statsInterval), [this]() { return statusStopped; })) {
+        auto now = std::chrono::steady_clock::now();
+        std::uint64_t sent = metrics->sent.load(std::memory_order_relaxed);
+        double seconds = std::chrono::duration<double>(now - lastTime).count();
+        double rate = seconds > 0 ? static_cast<double>(sent - lastSent) / seconds : 0.0;
+        lastSent = sent;
+        lastTime = now;
+        const LatencyHistogram& latency = metrics->overall();
+        std::cerr << fmt::format("[status] {:.1f}s | {:.0f} probes/s | {}/{} in flight | {} open, {} refused, {} timeouts | {} retries, {} throttles | rtt p50 {:.2f} ms, p99 {:.2f} ms\n",
+            getElapsed(), rate, metrics->inFlight.load(), maxConnections,
+            metrics->open.load(), metrics->refused.load(), metrics->timeouts.load(),
+            metrics->retries.load(), metrics->throttles.load(),
+            latency.quantile(0.5).count() / 1000.0, latency.quantile(0.99).count() / 1000.0);
+    }
+}
+
+
+void Scanner::writeStats() {
+    /**
+     * @brief Writes the final metrics to `statsFile` as a single JSON object.
+     *
+     * Latencies are in microseconds. Histogram bucket i counts the answers faster than
+     * 2^(i+1) us that didn't fit an earlier bucket, and every target that answered gets its
+     * own histogram.
+     */
+    auto appendHistogram = [](std::string& out, const LatencyHistogram& histogram) {
+        out += fmt::format("{{\"count\":{},\"p50\":{},\"p90\":{},\"p99\":{},\"buckets\":[",
+            histogram.count(), histogram.quantile(0.5).count(), histogram.quantile(0.9).count(), histogram.quantile(0.99).count());
+        std::array<std::uint64_t, LatencyHistogram::BUCKETS> buckets = histogram.buckets();
+        for (std::size_t i = 0; i < buckets.size(); ++i) {
+            out += (i ? "," : "") + std::to_string(buckets[i]);
+        }
+        out += "]}";
+    };
+
+    float elapsed = getElapsed();
+    std::uint64_t sent = metrics->sent.load();
+    std::string json = fmt::format("{{\"elapsed_seconds\":{:.2f},\"probes_sent\":{},\"probes_per_second\":{:.0f},\"max_connections\":{},\"peak_in_flight\":{},"
+        "\"open\":{},\"refused\":{},\"timeouts\":{},\"retries\":{},\"deferred\":{},\"parked\":{},\"throttles\":{},\"latency_us\":",
+        elapsed, sent, elapsed > 0 ? sent / elapsed : 0.0, maxConnections, metrics->peakInFlight.load(),
+        metrics->open.load(), metrics->refused.load(), metrics->timeouts.load(), metrics->retries.load(), metrics->deferred.load(), metrics->parked.load(), metrics->throttles.load());
+    appendHistogram(json, metrics->overall());
+    json += ",\"targets\":[";
+    bool first = true;
+    for (std::size_t targetIndex : metrics->measuredTargets()) {
+        Target target = targets.at(targetIndex);
+        json += first ? "{\"host\":" : ",{\"host\":";
+        appendJsonString(json, target.hostname.empty() ? target.address.to_string() : target.hostname);
+        json += ",\"address\":";
+        appendJsonString(json, target.address.to_string());
+        json += ",\"latency_us\":";
+        appendHistogram(json, *metrics->histogramFor(targetIndex));
+        json += "}";
+        first = false;
+    }
+    json += "]}\n";
+
+    if (statsFile == "-") {
+        std::cout << json << std::flush;
+        return;
     }
+    std::ofstream file(statsFile);
+    if (!file || !(file << json)) {
+        logger->error("Unable to write the stats file '{}'", statsFile);
+    }
+}
+
+
+void Scanner::prepareScan() {
+    /**
+     * @brief Resets the state a scan builds up, so every scan (and watch round) starts fresh.
+     *
+     * The per target tables are hashed over at most 65536 buckets.
+     */
+    std::size_t buckets = std::clamp<std::size_t>(targets.size(), 1, 65536);
+    targetRtt = std::vector<RttEstimator>(buckets);
+    globalRate = std::make_unique<RateLimiter>(maxRate);
+    hostRate = std::make_unique<RateLimiter>(maxHostRate, buckets);
+    int hostCap = maxHostConnections > 0 ? maxHostConnections
+        : maxConnections / static_cast<int>(std::clamp<std::size_t>(targets.size(), 1, HOST_SHARE));
+    hostScheduler = std::make_unique<HostScheduler>(hostCap, buckets);
+    results = std::make_unique<ResultStore>(targets.size());
+    liveHosts = std::make_unique<LiveHosts>(targets.size());
+    retryPassesLeft = retryPasses;
+}
+
+
+void Scanner::scan() {
+    /**
+     * @brief Initiates the scanning process.
+     *
+     * Pulls probes lazily through each shard's limiter, so memory use follows the concurrency
+     * limit rather than the size of the scan, then merges the shard results into `results`.
+     * With `-m syn` the probes are sent by the SynScanner engine from a single shard instead,
+     * falling back to connects if it can't open its raw socket. With `--resume` the work saved
+     * in the checkpoint is skipped and its results are carried over. With `--discover` only the
+     * hosts that answer a discovery pass are scanned, and with `--randomize` the probes are
+     * shuffled over every target and port. A watch round with `roundProbes` set probes only
+     * those pairs and skips host discovery. Probes that time out are retried in up to
+     * `retryPasses` passes once everything else has been probed.
+     * Connect probes take turns over the targets, and `hostScheduler` keeps a target that
+     * times out from holding more than its share of the connection slots.
+     */
+    prepareScan();
+    loadCheckpoint();
+    loadSeed();
+    if (logger) {
+        logger->debug("[Scanner::scan] Queued {} probes behind {} connection slots",
+            ProbeSource(targets.size(), ports).total(), maxConnections);
+    }
+
+    // gets thread hint with a mininum value of 1
+    unsigned int threads = threadCount > 0 ? static_cast<unsigned int>(threadCount) : std::max(1u, std::thread::hardware_concurrency());
+    if (isDiscoveryMode && !roundProbes) {
+        discoverHosts(threads);
+    }
+
+    if (scanMode == "syn") {
+        createShards(1, 1, ports, isDiscoveryMode ? &liveTargets : nullptr);
+        applyCheckpoint();
+        std::thread checkpointer = startCheckpoints();
+        SynScanner synScanner(*this, *shards.front());
+        bool finished = synScanner.run();
+        if (finished) {
+            stopCheckpoints(checkpointer);
+            retryDeferred(threads);
+            mergeShardResults();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(checkpointMutex);
+            scanFinished = true;
+        }
+        checkpointWake.notify_all();
+        if (checkpointer.joinable()) {
+            checkpointer.join();
+        }
+        scanFinished = false;
+        shards.clear();
+        logger->warn("Falling back to a connect scan");
+        scanMode = "connect";
+    }
+
+    runShards(threads);
+    retryDeferred(threads);
+    resolver->join();
+    mergeShardResults();
+}
+
+void Scanner::loadServices() {
+    /**
+     * @brief Loads the port to service names from `servicesFile`, if one was given.
+     */
+    if (servicesFile.empty()) {
+        return;
+    }
+    if (!loadServicesFile(servicesFile)) {
+        logger->error("Unable to read the services file '{}'; using the built in service names", servicesFile);
+        return;
+    }
+    logger->debug("[Scanner::loadServices] Loaded service names from {}", servicesFile);
+}
+
+
+void Scanner::loadSignatures() {
+    /**
+     * @brief Compiles the service signatures used by the banner stage.
+     *
+     * Signatures from `signatureFile` are added first so they win over the built in ones.
+     * Without --banners nothing is loaded.
+     */
+    if (!isBannerMode) {
+        return;
+    }
+    if (!signatureFile.empty() && !serviceMatcher.loadFile(signatureFile)) {
+        logger->error("Unable to read the signature file '{}'", signatureFile);
+    }
+    serviceMatcher.addBuiltinSignatures();
+    serviceMatcher.compile();
+    bannerGrabber = std::make_unique<BannerGrabber>(serviceMatcher, std::chrono::milliseconds(bannerTimeout));
+    logger->debug("[Scanner::loadSignatures] Compiled {} service signatures", serviceMatcher.size());
+}
+
+
+void Scanner::createLogger() {
+    /**
+     * @brief Creates and configures the logger instance.
+     *
+     * Retrieves an existing logger or creates a new one if necessary. Sets the logging level and
+     * formatting based on `isDebugMode` and `isVerboseMode`
+     */
+    logger = spdlog::get("bps");
+    if (!logger) {
+        logger = spdlog::get("shared_logger");
+    }
+    if (!logger) {
+        logger = spdlog::stdout_color_mt("shared_logger");
+    }
+    if (isVerboseMode) {
+        logger->set_level(spdlog::level::info);
+    }
+    else if (isDebugMode) {
+        logger->set_level(spdlog::level::debug);
+        logger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%l] %v");
+        logger->debug("[Scanner::createLogger] Debug logging enabled.");
+    }
+    else {
+        logger->set_level(spdlog::level::warn);
+    }
+}
+
+void Scanner::loadTimingTemplate() {
+    /**
+     * @brief Loads the timing template to configure scanning performance parameters.
+     *
+     * Sets the starting values and bounds of the adaptive timing based on a timing template; the
+     * congestion window and per-target round trip estimates take over once the scan is running.
+     * The connection counts are lowered to what the open file limit and the ephemeral port range
+     * of this process allow, as connections past them only fail with EAGAIN; reading the
+     * limits raises the open file limit to its hard maximum. With --banners the banner reads
+     * that run apart from their probe slot get a share of that budget too.
+     * Logs warnings if a high-performance (and potentially error-prone) timing template is selected.
+     */
+    timingTemplate = TimingTemplate::forLevel(timing);
+    SocketBudget budget = SocketBudget::read();
+    int wanted = timingTemplate.maxConnections;
+    int banners = isBannerMode ? wanted / BANNER_SHARE : 0;
+    int fitted = budget.fit(wanted + banners, RESERVED_FILES + static_cast<std::size_t>(dnsConcurrency), sourceAddresses.size());
+    if (isBannerMode) {
+        fitted = std::max(1, fitted * BANNER_SHARE / (BANNER_SHARE + 1));
+    }
+    fitted = std::min(fitted, wanted);
+    maxBannerSessions = std::max(1, fitted / BANNER_SHARE);
+    if (fitted < timingTemplate.maxConnections && logger) {
+        logger->warn("Lowering the connection budget from {} to {} to fit the open file limit ({}) and the ephemeral ports ({} per source address)",
+            timingTemplate.maxConnections, fitted, budget.fileLimit, budget.ephemeralPorts);
+    }
+    timingTemplate = timingTemplate.limit(fitted);
+    maxConnections = timingTemplate.maxConnections;
+
+    if (timing == 0 && logger)
+        logger->warn("Using `-T 0` this will be extremely slow!!!!");
 
     if (timing >= 5 && logger)
         logger->warn("Using this high of a timing template may cause false postives");
  
     if (logger) {
-        logger->debug("[Scanner::loadTimingTemplate()] Using {} max connections", maxConnections);
-        logger->debug("[Scanner::loadTimingTemplate()] Connection timeout is {} seconds", timeout);
+        logger->debug("[Scanner::loadTimingTemplate()] Using {} initial connections ({} - {})",
+            timingTemplate.initialConnections, timingTemplate.minConnections, timingTemplate.maxConnections);
+        logger->debug("[Scanner::loadTimingTemplate()] Connection timeout starts at {} ms ({} - {} ms)",
+            timingTemplate.initialTimeout.count(), timingTemplate.minTimeout.count(), timingTemplate.maxTimeout.count());
     }
 
 }
 
 
+void Scanner::loadSourceAddresses() {
+    /**
+     * @brief Parses `sourceAddressSpec` and keeps the addresses a socket can be bound to.
+     *
+     * Addresses that don't parse or aren't assigned to this machine are reported and skipped,
+     * so a typo can't make every probe fail.
+     */
+    std::stringstream ss(sourceAddressSpec);
+    std::string spec;
+    boost::asio::io_context ctx;
+    while (std::getline(ss, spec, ',')) {
+        if (spec.empty()) {
+            continue;
+        }
+        boost::system::error_code ec;
+        boost::asio::ip::address address = boost::asio::ip::make_address(spec, ec);
+        if (!ec) {
+            boost::asio::ip::tcp::socket socket(ctx);
+            ec = bindSource(socket, address.is_v4() ? boost::asio::ip::tcp::v4() : boost::asio::ip::tcp::v6(), address);
+        }
+        if (ec) {
+            if (logger) {
+                logger->error("Ignoring the source address '{}': {}", spec, ec.message());
+            }
+            continue;
+        }
+        sourceAddresses.push_back(address);
+    }
+    if (!sourceAddresses.empty() && logger) {
+        logger->debug("[Scanner::loadSourceAddresses] Spreading the connects over {} source address(es)", sourceAddresses.size());
+    }
+}
+
+
+const boost::asio::ip::address* Scanner::sourceFor(std::size_t slotId, const boost::asio::ip::address& target) const {
+    /**
+     * @brief Picks the source address of a probe.
+     *
+     * Each slot sticks to one address, so the slots of a shard are spread evenly over them.
+     *
+     * @param slotId The id of the slot running the probe.
+     * @param target The address about to be connected to.
+     * @return The slot's address of the target's family, or nullptr if there is none.
+     */
+    for (std::size_t i = 0; i < sourceAddresses.size(); ++i) {
+        const boost::asio::ip::address& source = sourceAddresses[(slotId + i) % sourceAddresses.size()];
+        if (source.is_v4() == target.is_v4()) {
+            return &source;
+        }
+    }
+    return nullptr;
+}
+
+
 void Scanner::start() {
     /**
      * @brief Starts the scanning operation.
      *
      * Begins the scanning process, shows the scan results,
-     * and outputs the total elapsed time for the scan.
+     * and outputs the total elapsed time for the scan. With `--output` the results are also
+     * streamed while scanning; streaming to stdout replaces the banner and the report.
+     * `--stats-interval` adds a live status line and `--stats-file` a final metrics dump.
      */
-    std::cout << "starting BPS (https://github.com/Drew-Alleman/bps)" << std::endl;
+    bool streamToStdout = outputFile == "-";
+    if (!outputFile.empty()) {
+        outputSink = OutputSink::open(outputFile, outputFormat);
+        if (!outputSink && logger) {
+            logger->error("Unable to open the output file '{}'", outputFile);
+        }
+    }
+    if (!streamToStdout) {
+        std::cout << "starting BPS (https://github.com/Drew-Alleman/bps)" << std::endl;
+    }
+    metrics = std::make_unique<ScanMetrics>(targets.size());
+    std::thread status;
+    if (statsInterval > 0) {
+        status = std::thread([this]() { runStatus(); });
+    }
     scan();
-    displayResults();
+    if (status.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(statusMutex);
+            statusStopped = true;
+        }
+        statusWake.notify_all();
+        status.join();
+    }
+    if (outputSink) {
+        outputSink->close();
+    }
+    if (!streamToStdout) {
+        displayResults();
+    }
     float elapsedTime = getElapsed();
-    //std::cout << "BPS done: " << targets.size() << " IP address scanned in "
-    //    << std::fixed << std::setprecision(2) << elapsedTime << " seconds" << std::endl;
+    if (!streamToStdout) {
+        std::cout << "BPS done: " << targets.size() << " IP address(es) scanned in "
+            << std::fixed << std::setprecision(2) << elapsedTime << " seconds ("
+            << metrics->sent.load() << " probes)" << std::endl;
+    }
+    if (!statsFile.empty()) {
+        writeStats();
+    }
+}
+
+
+
+void Scanner::startAsync(const boost::asio::any_io_executor& executor, std::function<void()> onDone) {
+    /**
+     * @brief Starts a scan on an executor owned by the caller and returns right away.
+     *
+     * Follows `scan()` on the connect engine, retry passes included, but a single shard runs
+     * on `executor` with a strand per probe slot, and the shards count their own work since
+     * nothing waits for their io_context to run dry. Ports are published as they are found; the results are
+     * merged into `results` just before `onDone` runs. The Scanner must outlive the scan.
+     *
+     * @param executor Runs every probe; any amount of threads may run it.
+     * @param onDone Called once every probe (and banner read) has finished or was cancelled.
+     */
+    asyncExecutor = executor;
+    metrics = std::make_unique<ScanMetrics>(targets.size());
+    prepareScan();
+    loadSeed();
+    if (scanMode == "syn") {
+        logger->warn("The SYN engine needs threads of its own; scanning with connects");
+        scanMode = "connect";
+    }
+    if (!outputFile.empty()) {
+        outputSink = OutputSink::open(outputFile, outputFormat);
+        if (!outputSink) {
+            logger->error("Unable to open the output file '{}'", outputFile);
+        }
+    }
+
+    std::function<void()> finish = [this, onDone = std::move(onDone)]() {
+        // A cancelled scan may leave lookups running; the report waits for them without
+        // blocking a thread of the executor.
+        resolver->whenFinished(asyncExecutor, [this, onDone]() {
+            mergeShardResults();
+            if (outputSink) {
+                outputSink->close();
+            }
+            onDone();
+            });
+    };
+    std::function<void(const std::vector<std::size_t>*)> scanPorts = [this, finish](const std::vector<std::size_t>* targetIndexes) {
+        runPhaseAsync(ports, targetIndexes, [this, finish]() {
+            retryDeferredAsync(finish);
+            });
+    };
+    if (!isDiscoveryMode) {
+        scanPorts(nullptr);
+        return;
+    }
+    runPhaseAsync(discoveryPorts, beginDiscovery(), [this, scanPorts]() {
+        endDiscovery();
+        scanPorts(&liveTargets);
+        });
+}
+
+
+void Scanner::runPhaseAsync(const std::vector<std::uint16_t>& shardPorts, const std::vector<std::size_t>* targetIndexes, std::function<void()> then,
+    std::size_t budgetShare) {
+    /**
+     * @brief Starts the shards of one pass over the targets (discovery or the scan itself).
+     *
+     * The shards of earlier passes are kept, since their last handler is still on the stack
+     * when `then` starts the next pass.
+     *
+     * @param shardPorts The ports probed on every target.
+     * @param targetIndexes The targets to probe, or nullptr for every target.
+     * @param then Called once every shard of this pass has finished.
+     * @param budgetShare Divides the connection budget, as for a retry pass.
+     */
+    std::vector<ScanShard*> started;
+    {
+        std::lock_guard<std::mutex> lock(shardsMutex);
+        std::size_t first = shards.size();
+        createShards(1, 1, shardPorts, targetIndexes, budgetShare);
+        for (std::size_t i = first; i < shards.size(); ++i) {
+            started.push_back(shards[i].get());
+        }
+    }
+    auto remaining = std::make_shared<std::atomic<std::size_t>>(started.size());
+    for (ScanShard* shard : started) {
+        shard->work.store(1);
+        shard->onFinished = [remaining, then]() {
+            if (remaining->fetch_sub(1) == 1) {
+                then();
+            }
+        };
+        boost::asio::post(shard->executor, [this, shard]() {
+            launchNextProbe(*shard);
+            });
+    }
+}
+
+
+void Scanner::cancel() {
+    /**
+     * @brief Stops the scan from any thread.
+     *
+     * Probes waiting for their send time or a retry are dropped and connects in flight are
+     * aborted. Banner reads and DNS lookups already running are left to finish.
+     */
+    cancelled = true;
+    std::lock_guard<std::mutex> lock(shardsMutex);
+    for (std::unique_ptr<ScanShard>& shard : shards) {
+        shard->probePool.cancelAll();
+    }
+}
+
+void Scanner::watch() {
+    /**
+     * @brief Scans the targets every `watchInterval` seconds and reports only the ports that changed.
+     *
+     * The first round of a run and every `fullSweepRounds`th round probe every target and port,
+     * after host discovery with --discover. The rounds in between only probe the ports kept in
+     * `history`: the open and filtered ones and those that closed recently. That is a tiny part
+     * of most scans, so the probe volume between sweeps drops by orders of magnitude, while a
+     * newly opened port is still found by the next sweep. Every change is printed with a
+     * timestamp and, with --output, written in its format with the new state. With --state-file
+     * the history survives a restart, and the first round reports what changed in the meantime.
+     */
+    bool streamToStdout = outputFile == "-";
+    std::unique_ptr<OutputSink> changeSink;
+    if (!outputFile.empty()) {
+        changeSink = OutputSink::open(outputFile, outputFormat);
+        if (!changeSink) {
+            logger->error("Unable to open the output file '{}'", outputFile);
+        }
+    }
+    if (!streamToStdout) {
+        std::cout << "starting BPS (https://github.com/Drew-Alleman/bps), scanning every " << watchInterval << " seconds" << std::endl;
+    }
+    loadHistory();
+    for (int round = 1; watchRounds == 0 || round <= watchRounds; ++round) {
+        auto roundStart = std::chrono::steady_clock::now();
+        startTime = std::chrono::high_resolution_clock::now();
+        bool fullSweep = round == 1 || history->rounds() % fullSweepRounds == 0;
+        std::vector<TargetPort> hotProbes;
+        if (!fullSweep) {
+            hotProbes = history->hotProbes();
+            roundProbes = &hotProbes;
+        }
+        shards.clear();
+        metrics = std::make_unique<ScanMetrics>(targets.size());
+        scan();
+        roundProbes = nullptr;
+
+        std::vector<PortChange> changes = history->update(*results);
+        reportChanges(changes, changeSink.get());
+        if (!stateFile.empty() && !history->save(stateFile)) {
+            logger->error("Unable to write the state file '{}'", stateFile);
+        }
+        if (!streamToStdout) {
+            std::cout << "BPS round " << history->rounds() << " ("
+                << (fullSweep ? std::string("full sweep") : std::to_string(hotProbes.size()) + " port(s) probed again") << "): "
+                << changes.size() << " change(s) in " << std::fixed << std::setprecision(2) << getElapsed() << " seconds ("
+                << metrics->sent.load() << " probes)" << std::endl;
+        }
+        if (round != watchRounds) {
+            std::this_thread::sleep_until(roundStart + std::chrono::seconds(watchInterval));
+        }
+    }
+    if (changeSink) {
+        changeSink->close();
+    }
+}
+
+
+void Scanner::loadHistory() {
+    /**
+     * @brief Loads the port states an earlier watch saved in `stateFile`.
+     *
+     * Without a file the history starts out empty, and so does one whose file belongs to a scan
+     * with other targets or ports.
+     */
+    std::uint64_t fingerprint = scanFingerprint();
+    if (!stateFile.empty() && std::ifstream(stateFile)) {
+        std::optional<PortHistory> loaded = PortHistory::load(stateFile);
+        if (!loaded) {
+            logger->error("Unable to read the state file '{}'; starting with no known ports", stateFile);
+        }
+        else if (loaded->fingerprint != fingerprint) {
+            logger->error("The state file '{}' belongs to a scan with different targets or ports; starting with no known ports", stateFile);
+        }
+        else {
+            history = std::make_unique<PortHistory>(std::move(*loaded));
+            logger->info("Watching with {} known port(s) from '{}' after {} round(s)", history->size(), stateFile, history->rounds());
+            return;
+        }
+    }
+    history = std::make_unique<PortHistory>();
+    history->fingerprint = fingerprint;
+}
+
+
+void Scanner::reportChanges(const std::vector<PortChange>& changes, OutputSink* sink) {
+    /**
+     * @brief Prints one timestamped line per changed port and writes the port to `sink` with its new state.
+     *
+     * @param changes The changes of the round that just finished.
+     * @param sink The --output sink, or nullptr.
+     */
+    std::string now = fmt::format("{:%Y-%m-%d %H:%M:%S}", fmt::localtime(std::time(nullptr)));
+    for (const PortChange& change : changes) {
+        Target target = targets.at(change.targetIndex);
+        std::string_view service = serviceName(*results, change.targetIndex, change.portInfo.port);
+        if (sink) {
+            sink->write(target, change.portInfo, service);
+        }
+        if (outputFile == "-") {
+            continue;
+        }
+        std::string_view verb = change.portInfo.status == PortState::Open ? "opened"
+            : change.portInfo.status == PortState::Filtered ? "filtered" : "closed";
+        std::cout << now << " " << verb << " " << change.portInfo.port << "/tcp on " << target.prettyName
+            << " (" << service << ", was " << state_to_string(change.previous) << ")\n";
+    }
+    std::cout << std::flush;
+}
+
+
+void Scanner::merge() {
+    /**
+     * @brief Combines the result files of earlier scans, e.g. the shards of a --shard scan.
+     *
+     * Every file is read in the format it was written in, which may differ between files. The
+     * hosts in the files become the targets of the report, ordered by address, and a port seen
+     * by several files keeps its most informative state (open before closed before filtered).
+     * The report is displayed like `displayResults()` does after a scan, and with `--output`
+     * the merged results are written in one file as well.
+     */
+    std::vector<ResultRecord> records;
+    for (const std::string& path : mergeFiles) {
+        std::ifstream file(path);
+        if (!file) {
+            logger->error("Unable to open the results file '{}'", path);
+            continue;
+        }
+        std::unique_ptr<OutputFormat> format;
+        std::size_t skipped = 0;
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                continue;
+            }
+            if (!format && !(format = OutputFormat::detect(line))) {
+                logger->error("'{}' is not a results file written with --output", path);
+                break;
+            }
+            ResultRecord record;
+            if (format->parse(line, record)) {
+                records.push_back(std::move(record));
+            }
+            else {
+                skipped++;
+            }
+        }
+        logger->debug("[Scanner::merge] Read {} with {} unreadable line(s)", path, skipped);
+    }
+
+    std::sort(records.begin(), records.end(), [](const ResultRecord& a, const ResultRecord& b) {
+        return std::tie(a.address, a.hostname, a.portInfo.port, a.portInfo.status)
+            < std::tie(b.address, b.hostname, b.portInfo.port, b.portInfo.status);
+        });
+    std::vector<std::size_t> targetIndexes;
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        if (i == 0 || records[i].address != records[i - 1].address || records[i].hostname != records[i - 1].hostname) {
+            targets.addHost(records[i].hostname.empty() ? Target(records[i].address) : Target(records[i].address, records[i].hostname));
+        }
+        targetIndexes.push_back(targets.size() - 1);
+    }
+    results = std::make_unique<ResultStore>(targets.size());
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        if (results->record(targetIndexes[i], records[i].portInfo) && !records[i].service.empty()) {
+            results->recordService(targetIndexes[i], records[i].portInfo.port, records[i].service);
+        }
+    }
+
+    bool streamToStdout = outputFile == "-";
+    if (!outputFile.empty()) {
+        outputSink = OutputSink::open(outputFile, outputFormat);
+        if (!outputSink) {
+            logger->error("Unable to open the output file '{}'", outputFile);
+        }
+    }
+    if (outputSink) {
+        for (std::size_t targetIndex : results->reportedTargets()) {
+            Target target = targets.at(targetIndex);
+            for (const PortInfo& portInfo : results->portsFor(targetIndex)) {
+                outputSink->write(target, portInfo, serviceName(*results, targetIndex, portInfo.port));
+            }
+        }
+        outputSink->close();
+    }
+    if (!streamToStdout) {
+        displayResults();
+        std::cout << "BPS merge done: " << records.size() << " result(s) from " << mergeFiles.size()
+            << " file(s) on " << targets.size() << " host(s)" << std::endl;
+    }
 }
@@ -4,29 +4,43 @@
 #define FMT_UNICODE 0
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/fmt/chrono.h"
 
 #include "config/config.h"
 #include "config/target.h"
+#include "config/target_space.h"
+#include "timing.h"
+#include "result_store.h"
+#include "scan_shard.h"
+#include "host_resolver.h"
+#include "output_sink.h"
+#include "checkpoint.h"
+#include "service_matcher.h"
+#include "banner_grabber.h"
+#include "scan_metrics.h"
+#include "rate_limiter.h"
+#include "host_scheduler.h"
+#include "socket_resources.h"
+#include "live_hosts.h"
+#include "port_history.h"
 
+#include <atomic>
 #include <iostream>
 #include <chrono>
+#include <functional>
+#include <string_view>
 #include <unordered_map>
 #include <sstream>
+#include <fstream>
 #include <algorithm>
 #include <cctype>    
 #include <thread>
-
-enum class PortState {
-    Open,
-    Closed,
-    Filtered,
-    Unknown
-};
-
-struct PortInfo {
-    int port;
-    PortState status;
-};
+#include <ctime>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <tuple>
 
 using namespace boost::asio;
 
@@ -34,64 +48,331 @@ class Scanner {
 public:
     Scanner(const Config& config)
         : targetString(config.targetString),
+        inputFile(config.inputFile),
+        hostsFile(config.hostsFile),
+        dnsConcurrency(config.dnsConcurrency),
         startPort(config.startPort),
         endPort(config.endPort),
+        ports(config.ports),
         isDebugMode(config.isDebugMode),
         isVerboseMode(config.isVerboseMode),
         timing(config.timing),
-        displayClosedPorts(config.displayClosedPorts)
+        scanMode(config.scanMode),
+        threadCount(config.threadCount),
+        isShardedMode(config.isShardedMode),
+        displayClosedPorts(config.displayClosedPorts),
+        outputFile(config.outputFile),
+        outputFormat(config.outputFormat),
+        checkpointFile(config.checkpointFile.empty() ? config.resumeFile : config.checkpointFile),
+        resumeFile(config.resumeFile),
+        checkpointInterval(config.checkpointInterval),
+        isBannerMode(config.isBannerMode),
+        bannerTimeout(config.bannerTimeout),
+        signatureFile(config.signatureFile),
+        servicesFile(config.servicesFile),
+        statsInterval(config.statsInterval),
+        statsFile(config.statsFile),
+        maxRate(config.maxRate),
+        maxHostRate(config.maxHostRate),
+        maxHostConnections(config.maxHostConnections),
+        sourceAddressSpec(config.sourceAddressSpec),
+        retryPasses(config.retryPasses),
+        isRandomOrder(config.isRandomOrder),
+        seed(config.seed),
+        processShard(config.shardIndex),
+        processShardCount(config.shardCount),
+        mergeFiles(config.mergeFiles),
+        isDiscoveryMode(config.isDiscoveryMode),
+        discoveryPorts(config.discoveryPorts),
+        watchInterval(config.watchInterval),
+        fullSweepRounds(config.fullSweepRounds),
+        watchRounds(config.watchRounds),
+        stateFile(config.stateFile)
     {
         createLogger();
+        loadSourceAddresses();
         loadTimingTemplate();
         loadTargets();
+        loadServices();
+        loadSignatures();
         startTime = std::chrono::high_resolution_clock::now();
     }
 
     std::string targetString;
+    // File with one target spec per line, read next to `targetString`.
+    std::string inputFile;
+    // Hosts file consulted before domains are looked up.
+    std::string hostsFile;
+    // The most DNS lookups in flight at once.
+    int dnsConcurrency;
     int startPort;
     int endPort;
-    int timeout;
+    // The ports probed on every target, most interesting first.
+    std::vector<std::uint16_t> ports;
     int timing;
+    // "connect" for full TCP connects, "syn" for the raw socket half-open engine.
+    std::string scanMode;
+    // Threads running the scan, 0 for one per core.
+    int threadCount;
+    // Gives each thread its own io_context and slice of the scan instead of sharing one.
+    bool isShardedMode;
     bool isDebugMode;
     bool isVerboseMode;
     bool displayClosedPorts;
+    // Where results are streamed while scanning ("-" for stdout), and in which format.
+    std::string outputFile;
+    std::string outputFormat;
+    // Where progress is saved every `checkpointInterval` seconds, and the checkpoint to resume from.
+    std::string checkpointFile;
+    std::string resumeFile;
+    int checkpointInterval;
+    // Identifies the services on open ports from their banners, waiting `bannerTimeout` ms per read.
+    bool isBannerMode;
+    int bannerTimeout;
+    // Extra signatures checked before the built in ones.
+    std::string signatureFile;
+    // nmap-services style file naming the usual service of each port.
+    std::string servicesFile;
+    // Seconds between status lines on stderr, 0 for none.
+    int statsInterval;
+    // Where the final metrics are written as JSON ("-" for stdout).
+    std::string statsFile;
+    // Probes per second in total and per target, 0 for no cap.
+    int maxRate;
+    int maxHostRate;
+    // Probes in flight per target while it answers, 0 for `maxConnections`.
+    int maxHostConnections;
+    // The local addresses connects are spread over, parsed from `sourceAddressSpec`.
+    std::string sourceAddressSpec;
+    std::vector<boost::asio::ip::address> sourceAddresses;
+    // Passes over the deferred probes after the main pass, 0 to give up on a timeout right away.
+    int retryPasses;
+    // Shuffles the probe order with `seed`; a seed of 0 is replaced by a random one when scanning.
+    bool isRandomOrder;
+    std::uint64_t seed;
+    // The slice of the scan this process runs when it is split over `processShardCount` processes.
+    std::size_t processShard;
+    std::size_t processShardCount;
+    // Result files combined by `merge()`.
+    std::vector<std::string> mergeFiles;
+    // Finds the live hosts by probing `discoveryPorts` before the full scan.
+    bool isDiscoveryMode;
+    std::vector<std::uint16_t> discoveryPorts;
+    // Rescans every `watchInterval` seconds, probing every port every `fullSweepRounds` rounds
+    // and only the ports in `history` in between; stops after `watchRounds` rounds unless 0.
+    int watchInterval;
+    int fullSweepRounds;
+    int watchRounds;
+    // Where `history` is kept between rounds and runs, empty to keep it in memory only.
+    std::string stateFile;
 
-    std::vector<Target> targets;
-    io_context ctx;
+    // Every target, kept as address ranges and only expanded one index at a time.
+    TargetSpace targets;
+    // The index of the first domain; domains are added after every address.
+    std::size_t firstDomain = 0;
+    // Resolves the domains in `targets` while the scan is already running.
+    std::unique_ptr<HostResolver> resolver;
+    // The slices of the scan, each with its own io_context, probe source, limiter and results.
+    std::vector<std::unique_ptr<ScanShard>> shards;
 
-    std::unordered_map<std::string, std::mutex> mutexMap;
-    std::unordered_map<std::string, std::vector<PortInfo>> scanResults;
-    std::mutex portsMutex;
+    // The state of every port, per target, merged from `shards` once the scan is done.
+    std::unique_ptr<ResultStore> results;
     std::shared_ptr<spdlog::logger> logger;
+    // Streams each newly recorded port when --output is given.
+    std::unique_ptr<OutputSink> outputSink;
+    // The compiled service signatures, and the banner stage using them when --banners is given.
+    ServiceMatcher serviceMatcher;
+    std::unique_ptr<BannerGrabber> bannerGrabber;
+    // The banner reads running apart from a probe slot, and how many may.
+    std::atomic<int> bannerSessions{ 0 };
+    int maxBannerSessions = 1;
+
+    // The checkpoint loaded with --resume, if it matched this scan.
+    std::optional<Checkpoint> resumed;
+    // Wakes the checkpoint thread early once the scan is done.
+    std::mutex checkpointMutex;
+    std::condition_variable checkpointWake;
+    bool scanFinished = false;
+
+    // Gets every newly recorded port, next to `outputSink`; set by the async API.
+    std::function<void(const Target& target, PortInfo portInfo, std::string_view service)> resultHandler;
+    // The executor of a scan started with `startAsync()`, empty when the scan runs its own threads.
+    boost::asio::any_io_executor asyncExecutor;
+    // Stops new probes and drops the ones waiting to be sent.
+    std::atomic<bool> cancelled{ false };
+    // Guards `shards` while an async scan adds its next phase and `cancel()` walks them.
+    std::mutex shardsMutex;
+
+    // Live counters and latency histograms, shared by every shard and both scan engines.
+    std::unique_ptr<ScanMetrics> metrics;
+    // Wakes the status thread once the scan is done.
+    std::mutex statusMutex;
+    std::condition_variable statusWake;
+    bool statusStopped = false;
 
     std::chrono::time_point<std::chrono::high_resolution_clock> startTime;
 
-    // New member variables for throttling
-    std::atomic<int> activeConnections;
     int maxConnections;
 
+    // Starting values and bounds for the adaptive timing, split between `shards`.
+    TimingTemplate timingTemplate;
+    // Round trip estimates shared by every shard; exact per target for up to 65536 targets,
+    // hashed by target index beyond that.
+    std::vector<RttEstimator> targetRtt;
+    // Pace the probes of every shard and both engines to `maxRate` and `maxHostRate`. The per
+    // target buckets are exact for up to 65536 targets and hashed by target index beyond that.
+    std::unique_ptr<RateLimiter> globalRate;
+    std::unique_ptr<RateLimiter> hostRate;
+    // Caps the connect probes in flight per target, shared by every shard like `hostRate`.
+    std::unique_ptr<HostScheduler> hostScheduler;
+
+    // Set while host discovery runs; its probes only mark `liveHosts` and record no ports.
+    bool isDiscovering = false;
+    // The targets that answered any probe of the running scan; the others get the initial timeout.
+    std::unique_ptr<LiveHosts> liveHosts;
+    // The targets that answered host discovery, the only ones the full scan probes.
+    std::vector<std::size_t> liveTargets;
+    // The targets this process discovers when the scan is split over processes.
+    std::vector<std::size_t> processTargets;
+    // The last known state of the ports worth watching, set by `watch()`.
+    std::unique_ptr<PortHistory> history;
+    // The pairs a watch round or a retry pass probes instead of every target and port, or nullptr.
+    const std::vector<TargetPort>* roundProbes = nullptr;
+    // The retry passes still to come in the running scan; probes are only deferred while above 0.
+    int retryPassesLeft = 0;
+    // The probes of the running retry pass.
+    std::vector<TargetPort> retryProbes;
+
     // Configures the logger.
     void createLogger();
-    // Configures `timeout` and `maxConnections` based on the value of `timing`
+    // Configures `timingTemplate` and `maxConnections` based on the value of `timing`, within the SocketBudget
     void loadTimingTemplate();
-    // Takes the provided string, and attempts to DNS resolve it to a IPV4 address
-    boost::optional<boost::asio::ip::address> resolveDomainFromString(const std::string& domain);
-    // Loads the IP addresses from --targets.
+    // Fills `sourceAddresses` with the usable addresses of `sourceAddressSpec`.
+    void loadSourceAddresses();
+    // The source address a slot connects to `target` from, or nullptr for the default one.
+    const boost::asio::ip::address* sourceFor(std::size_t slotId, const boost::asio::ip::address& target) const;
+    // Adds one target spec (address, CIDR block or range) to `targets`; domains are collected in `domains`.
+    void addTarget(const std::string& spec, std::vector<std::string>& domains);
+    // Loads the targets from --target and --input-file, and starts resolving the domains.
     void loadTargets();
-    // Updates the vector of open ports for the provided target.
-    void updateDictionary(Target target, PortInfo portInfo);
-    // Checks to see if the provided port is open on the target IP.
-    void isOpen(Target, int port, int retries);
-    void handleSocketError(
-        boost::asio::strand<boost::asio::io_context::executor_type> strand,
-        boost::system::error_code ec, int port,
-        Target target, int retries = 3);
-    // Scans the loaded targets; results will be stored in `scanResults`.
+    // Replaces the built in port to service names with `servicesFile` when one is given.
+    void loadServices();
+    // Compiles the service signatures and creates `bannerGrabber` when --banners is given.
+    void loadSignatures();
+    // The round trip estimator used for a target.
+    RttEstimator& rttFor(std::size_t targetIndex);
+    // Records a port in the shard's results; returns false if it was already recorded.
+    bool updateDictionary(ScanShard& shard, std::size_t targetIndex, PortInfo portInfo, bool streamResult = true);
+    // Hands the connected socket of an open port to `bannerGrabber` and records what it finds.
+    // Returns true if the slot waits for the read and is finished after it.
+    bool grabBanner(ScanShard& shard, ProbeSlot& slot, PortInfo portInfo);
+    // Writes a newly recorded port to `outputSink` and `resultHandler`.
+    void publishResult(const Target& target, PortInfo portInfo, std::string_view service);
+    // The service identified on a port, or the service usually found on it.
+    std::string_view serviceName(const ResultStore& store, std::size_t targetIndex, int port) const;
+    // Checks to see if the slot's port is open on the slot's target IP.
+    void isOpen(ScanShard& shard, ProbeSlot& slot);
+    // Starts the connect of a probe whose send time has come.
+    void connectProbe(ScanShard& shard, ProbeSlot& slot);
+    // True while discovering once the target has answered, so its other discovery probes can be skipped.
+    bool isDiscovered(std::size_t targetIndex) const;
+    // Claims a send under both rate caps and returns when the probe for a target may go out.
+    std::chrono::steady_clock::time_point reserveSend(std::size_t targetIndex);
+    // Records the outcome of a failed connect: a deferral, a port state or a log line.
+    void handleSocketError(ScanShard& shard, ProbeSlot& slot, boost::system::error_code ec);
+    // Hands a finished slot back to the shard's probe pool and limiter.
+    void finishProbe(ScanShard& shard, ProbeSlot& slot);
+    // Ends a piece of the shard's work, calling its `onFinished` after the last one.
+    void releaseWork(ScanShard& shard);
+    // The connect deadline for a target, derived from its round trip estimates.
+    std::chrono::milliseconds probeTimeout(std::size_t targetIndex);
+    // Feeds the round trip time of an answered probe into the estimators and the shard's window.
+    void recordResponse(ScanShard& shard, std::size_t targetIndex, std::chrono::microseconds rtt, PortState state);
+    // Counts a probe that timed out and shrinks the shard's window.
+    void recordTimeout(ScanShard& shard);
+    // Handles a probe that got no answer in time: defers it to a retry pass, or gives up on it.
+    void recordUnanswered(ScanShard& shard, std::size_t targetIndex, int port);
+    // Puts a probe off to the next retry pass; returns false if no pass is left to take it.
+    bool deferProbe(ScanShard& shard, std::size_t targetIndex, int port, bool isSendFailure);
+    // Gathers the deferred probes of every shard (and of a resumed checkpoint), dropping
+    // timeouts on targets that never answered.
+    std::vector<TargetPort> collectDeferred();
+    // Runs the retry passes over the deferred probes once the main pass is done.
+    void retryDeferred(unsigned int threads);
+    // Runs the retry passes of a scan started with `startAsync()`, then calls `then`.
+    void retryDeferredAsync(std::function<void()> then);
+    // Counts the kernel running out of resources for a probe and shrinks the shard's window.
+    void recordResourceExhausted(ScanShard& shard);
+    // Waits for a free connection slot, then pulls the shard's next probe and starts it.
+    void launchNextProbe(ScanShard& shard);
+    // Hands `slot` the shard's next probe whose target has room, parking the ones that don't.
+    std::optional<Probe> nextProbe(ScanShard& shard, ProbeSlot& slot);
+    // Restarts the shard's launcher if it is idle and the park list has room again.
+    void wakeLauncher(ScanShard& shard);
+    // The most probes a shard parks before its launcher waits.
+    std::size_t parkLimit(const ScanShard& shard) const;
+    // The seed shards shuffle their probes with, or nothing for the plain order.
+    std::optional<std::uint64_t> orderSeed() const;
+    // Picks the seed of a shuffled scan: the checkpoint's when resuming, else `seed` or a random one.
+    void loadSeed();
+    // Fills `shards` with slices of `shardPorts` on the given targets (every target for nullptr),
+    // sharing 1/`budgetShare` of the connection budget; returns the amount of threads per shard.
+    int createShards(std::size_t shardCount, unsigned int threads, const std::vector<std::uint16_t>& shardPorts,
+        const std::vector<std::size_t>* targetIndexes, std::size_t budgetShare = 1);
+    // Runs the io_contexts of `shards` until every probe is done.
+    void runShardThreads(int threadsPerShard);
+    // Splits the scan into `shards` and runs their io_contexts until every probe is done.
+    void runShards(unsigned int threads);
+    // Probes `discoveryPorts` on every target and fills `liveTargets` with the ones that answered.
+    void discoverHosts(unsigned int threads);
+    // Switches the probe paths to discovery; returns the targets to discover, nullptr for all of them.
+    const std::vector<std::size_t>* beginDiscovery();
+    // Collects the hosts that answered into `liveTargets` and switches back to scanning.
+    void endDiscovery();
+    // Folds the results of every shard into `results`.
+    void mergeShardResults();
+    // Identifies the targets and ports of this scan for checkpoints; without `includeShard`
+    // it is the same on every process of a scan split with --shard.
+    std::uint64_t scanFingerprint(bool includeShard = true) const;
+    // Loads `resumeFile` into `resumed` and `results`.
+    void loadCheckpoint();
+    // Moves the shards past the work `resumed` says is done; they must match its layout.
+    void applyCheckpoint();
+    // Saves the current progress of `shards` to `checkpointFile`.
+    void saveCheckpoint();
+    // Saves a checkpoint every `checkpointInterval` seconds until `scanFinished` is set.
+    void runCheckpoints();
+    // Starts the checkpoint thread when --checkpoint or --resume is given.
+    std::thread startCheckpoints();
+    // Stops the checkpoint thread and saves a final checkpoint.
+    void stopCheckpoints(std::thread& checkpointer);
+    // Prints a status line to stderr every `statsInterval` seconds until `statusStopped` is set.
+    void runStatus();
+    // Writes the final metrics to `statsFile` as JSON.
+    void writeStats();
+    // Creates the per scan state shared by `scan()` and `startAsync()`: estimators, rate caps,
+    // the host scheduler and an empty `results`.
+    void prepareScan();
+    // Scans the loaded targets; results will be stored in `results`.
     void scan();
-    // If the max amount of connections are met, we simply wait here
-    void throttleConnectionIfNeeded(Target, int port, int retries);
     // Loads arguments, scans the targets, and displays results.
     void start();
+    // Scans on `executor` instead of threads of its own and calls `onDone` from the thread that
+    // finishes the last probe. Connect scans only; no checkpoints or status line.
+    void startAsync(const boost::asio::any_io_executor& executor, std::function<void()> onDone);
+    // Runs the probes of `shardPorts` on the given targets on `asyncExecutor`, then calls `then`.
+    void runPhaseAsync(const std::vector<std::uint16_t>& shardPorts, const std::vector<std::size_t>* targetIndexes, std::function<void()> then,
+        std::size_t budgetShare = 1);
+    // Stops a running scan: nothing new is sent and the probes in flight are aborted.
+    void cancel();
+    // Rescans the targets every `watchInterval` seconds and reports the ports that changed.
+    void watch();
+    // Loads `history` from `stateFile`, or starts an empty one.
+    void loadHistory();
+    // Prints the changes of a watch round and writes them to `sink`, if any.
+    void reportChanges(const std::vector<PortChange>& changes, OutputSink* sink);
+    // Combines the result files in `mergeFiles` into `results` and displays them like a scan.
+    void merge();
     // Displays the open ports on the scanned targets.
     void displayResults();
     // Calculates the elapsed time.
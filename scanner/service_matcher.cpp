@@ -0,0 +1,211 @@
+#include "service_matcher.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <queue>
+
+namespace {
+    // Earlier entries win, so the specific signatures come before the generic ones.
+    const ServiceSignature BUILTIN_SIGNATURES[] = {
+        { "SSH", "SSH-", true },
+        { "HTTP (nginx)", "\r\nserver: nginx", false },
+        { "HTTP (Apache)", "\r\nserver: apache", false },
+        { "HTTP (IIS)", "\r\nserver: microsoft-iis", false },
+        { "HTTP (lighttpd)", "\r\nserver: lighttpd", false },
+        { "HTTP (Caddy)", "\r\nserver: caddy", false },
+        { "Elasticsearch", "\"cluster_name\"", false },
+        { "MongoDB", "trying to access mongodb over http", false },
+        { "RTSP", "RTSP/1.0", true },
+        { "SIP", "SIP/2.0", true },
+        { "HTTP", "HTTP/", true },
+        { "SMTP", "esmtp", false },
+        { "SMTP", "smtp", false },
+        { "FTP", "ftp", false },
+        { "FTP", "220-", true },
+        { "POP3", "+OK", true },
+        { "IMAP", "* OK", true },
+        { "MySQL", "mysql_native_password", false },
+        { "MySQL (MariaDB)", "mariadb", false },
+        { "MySQL", "mysql", false },
+        { "PostgreSQL", "invalid length of startup packet", false },
+        { "Redis", "-ERR ", true },
+        { "Memcached", "ERROR\r\n", true },
+        { "VNC", "RFB ", true },
+        { "AMQP", "AMQP", true },
+        { "rsync", "@RSYNCD:", true },
+        { "Telnet", "\xff\xfb", true },
+        { "Telnet", "\xff\xfd", true },
+        { "SSL/TLS", "\x15\x03\x01", true },
+        { "SSL/TLS", "\x15\x03\x03", true },
+        { "SSL/TLS", "\x16\x03", true },
+    };
+
+    unsigned char fold(unsigned char c) {
+        return static_cast<unsigned char>(std::tolower(c));
+    }
+
+    bool unescape(const std::string& text, std::string& out) {
+        /**
+         * @brief Decodes \r, \n, \t, \0, \\ and \xNN in a signature pattern.
+         *
+         * @return false if an escape is incomplete or unknown.
+         */
+        out.clear();
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            if (text[i] != '\\') {
+                out += text[i];
+                continue;
+            }
+            if (++i == text.size()) {
+                return false;
+            }
+            switch (text[i]) {
+            case 'r':  out += '\r'; break;
+            case 'n':  out += '\n'; break;
+            case 't':  out += '\t'; break;
+            case '0':  out += '\0'; break;
+            case '\\': out += '\\'; break;
+            case '^':  out += '^'; break;
+            case 'x':
+                if (i + 2 >= text.size() || !std::isxdigit(static_cast<unsigned char>(text[i + 1])) || !std::isxdigit(static_cast<unsigned char>(text[i + 2]))) {
+                    return false;
+                }
+                out += static_cast<char>(std::stoi(text.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void ServiceMatcher::addBuiltinSignatures() {
+    for (const ServiceSignature& signature : BUILTIN_SIGNATURES) {
+        add(signature);
+    }
+}
+
+bool ServiceMatcher::loadFile(const std::string& path) {
+    /**
+     * @brief Adds the signatures from a file.
+     *
+     * Each line holds a service name, a tab and the pattern. A pattern starting with ^ only
+     * matches at the start of the response (\^ for a literal caret), and \r, \n, \t, \0, \\ and
+     * \xNN escapes are decoded. Empty lines, lines starting with # and malformed lines are skipped.
+     *
+     * @param path The signature file.
+     * @return false if the file can't be opened.
+     */
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        std::size_t tab = line.find('\t');
+        if (line.empty() || line[0] == '#' || tab == std::string::npos || tab == 0) {
+            continue;
+        }
+        ServiceSignature signature;
+        signature.service = line.substr(0, tab);
+        std::string pattern = line.substr(tab + 1);
+        if (!pattern.empty() && pattern[0] == '^') {
+            signature.anchored = true;
+            pattern.erase(0, 1);
+        }
+        if (!unescape(pattern, signature.pattern) || signature.pattern.empty()) {
+            continue;
+        }
+        add(std::move(signature));
+    }
+    return true;
+}
+
+void ServiceMatcher::add(ServiceSignature signature) {
+    signatures.push_back(std::move(signature));
+}
+
+void ServiceMatcher::compile() {
+    /**
+     * @brief Builds the Aho-Corasick automaton over every signature.
+     *
+     * The patterns are inserted into a trie on case folded bytes, then a breadth first walk sets
+     * the failure links and turns them into direct transitions, so `match()` is a single table
+     * lookup per byte.
+     */
+    states.assign(1, State{});
+    states[0].next.fill(-1);
+    for (std::uint32_t id = 0; id < signatures.size(); ++id) {
+        std::int32_t state = 0;
+        for (char c : signatures[id].pattern) {
+            unsigned char byte = fold(static_cast<unsigned char>(c));
+            if (states[state].next[byte] < 0) {
+                states[state].next[byte] = static_cast<std::int32_t>(states.size());
+                states.push_back(State{});
+                states.back().next.fill(-1);
+            }
+            state = states[state].next[byte];
+        }
+        states[state].matches.push_back(id);
+    }
+
+    std::vector<std::int32_t> fail(states.size(), 0);
+    std::queue<std::int32_t> pending;
+    for (std::int32_t& next : states[0].next) {
+        if (next < 0) {
+            next = 0;
+        }
+        else {
+            pending.push(next);
+        }
+    }
+    while (!pending.empty()) {
+        std::int32_t state = pending.front();
+        pending.pop();
+        const std::vector<std::uint32_t>& inherited = states[fail[state]].matches;
+        states[state].matches.insert(states[state].matches.end(), inherited.begin(), inherited.end());
+        for (std::size_t byte = 0; byte < 256; ++byte) {
+            std::int32_t next = states[state].next[byte];
+            if (next < 0) {
+                states[state].next[byte] = states[fail[state]].next[byte];
+            }
+            else {
+                fail[next] = states[fail[state]].next[byte];
+                pending.push(next);
+            }
+        }
+    }
+}
+
+std::string ServiceMatcher::match(std::string_view response) const {
+    /**
+     * @brief Finds the best signature in a response.
+     *
+     * @param response What the service sent.
+     * @return The service of the earliest added signature that matches, or an empty string.
+     */
+    if (states.empty()) {
+        return "";
+    }
+    std::uint32_t best = static_cast<std::uint32_t>(signatures.size());
+    std::int32_t state = 0;
+    for (std::size_t i = 0; i < response.size(); ++i) {
+        state = states[state].next[fold(static_cast<unsigned char>(response[i]))];
+        for (std::uint32_t id : states[state].matches) {
+            if (id < best && (!signatures[id].anchored || signatures[id].pattern.size() == i + 1)) {
+                best = id;
+            }
+        }
+    }
+    return best < signatures.size() ? signatures[best].service : "";
+}
+
+std::size_t ServiceMatcher::size() const {
+    return signatures.size();
+}
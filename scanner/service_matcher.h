@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A byte string that identifies a service when it shows up in what the service sends.
+struct ServiceSignature {
+    std::string service;
+    std::string pattern;
+    // Only matches at the very start of the response.
+    bool anchored = false;
+};
+
+// Identifies services from their banners. Every signature is compiled into one Aho-Corasick
+// automaton, so a response is checked against all of them in a single pass no matter how many
+// there are. Matching ignores ASCII case, and when several signatures match, the one that was
+// added first wins.
+class ServiceMatcher {
+public:
+    // Adds the signatures that ship with bps.
+    void addBuiltinSignatures();
+    // Adds the signatures in `path`; returns false if the file can't be read.
+    bool loadFile(const std::string& path);
+    void add(ServiceSignature signature);
+    // Builds the automaton; call it once after the last signature was added.
+    void compile();
+    // The service of the best signature found in `response`, or an empty string.
+    std::string match(std::string_view response) const;
+    std::size_t size() const;
+
+private:
+    struct State {
+        // Full transition table, so matching never has to follow failure links.
+        std::array<std::int32_t, 256> next;
+        // The signatures that end in this state, including those reached through failure links.
+        std::vector<std::uint32_t> matches;
+    };
+
+    std::vector<ServiceSignature> signatures;
+    std::vector<State> states;
+};
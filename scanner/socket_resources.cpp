@@ -0,0 +1,140 @@
+#include "socket_resources.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#endif
+
+#if defined(__linux__) && !defined(IP_BIND_ADDRESS_NO_PORT)
+#define IP_BIND_ADDRESS_NO_PORT 24
+#endif
+
+SocketBudget SocketBudget::read() {
+    /**
+     * @brief Reads the open file limit and the ephemeral port range.
+     *
+     * The soft open file limit is often 1024 while the hard limit is far higher, so it is
+     * raised to the hard limit first; that is all an unprivileged process may do. Windows
+     * has neither limit, so nothing is capped there.
+     *
+     * @return The limits, with 0 for the ones that are unknown.
+     */
+    SocketBudget budget;
+#ifndef _WIN32
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        if (limit.rlim_cur < limit.rlim_max) {
+            struct rlimit raised = limit;
+            raised.rlim_cur = raised.rlim_max;
+            if (setrlimit(RLIMIT_NOFILE, &raised) == 0) {
+                limit = raised;
+            }
+        }
+        if (limit.rlim_cur != RLIM_INFINITY) {
+            budget.fileLimit = static_cast<std::size_t>(limit.rlim_cur);
+        }
+    }
+#endif
+#ifdef __linux__
+    std::ifstream range("/proc/sys/net/ipv4/ip_local_port_range");
+    long low = 0;
+    long high = 0;
+    if (range >> low >> high && high >= low && low > 0 && high <= 65535) {
+        budget.ephemeralPorts = static_cast<std::size_t>(high - low + 1);
+        budget.firstEphemeralPort = static_cast<std::uint16_t>(low);
+        budget.lastEphemeralPort = static_cast<std::uint16_t>(high);
+    }
+#endif
+    return budget;
+}
+
+int SocketBudget::fit(int connections, std::size_t reservedFiles, std::size_t sourceCount) const {
+    /**
+     * @brief Caps a connection count to the limits.
+     *
+     * A limit too small for the reserve still leaves half of it to the probes.
+     *
+     * @param connections The connections wanted.
+     * @param reservedFiles The descriptors kept free for logs, output files, DNS and the event loops.
+     * @param sourceCount The source addresses the probes are spread over, 0 for the default one.
+     * @return Between 1 and `connections`.
+     */
+    std::size_t fitted = static_cast<std::size_t>(std::max(1, connections));
+    if (fileLimit > 0) {
+        fitted = std::min(fitted, fileLimit > reservedFiles * 2 ? fileLimit - reservedFiles : fileLimit / 2);
+    }
+    if (ephemeralPorts > 0) {
+        fitted = std::min(fitted, ephemeralPorts * std::max<std::size_t>(1, sourceCount));
+    }
+    return static_cast<int>(std::max<std::size_t>(1, fitted));
+}
+
+std::uint16_t SocketBudget::portsOutsideEphemeral(std::size_t& count) const {
+    /**
+     * @brief Finds local ports the kernel won't hand out to its own connections.
+     *
+     * A raw socket sender owns no kernel socket, so its source ports must not collide with the
+     * ones the kernel picks for the connects and DNS lookups running next to it. The ports below
+     * the range are preferred as the default range leaves far more room there; without a known
+     * range the top of the port space is used.
+     *
+     * @param count The ports wanted; lowered to what fits.
+     * @return The first port, or 0 if none is free.
+     */
+    constexpr std::size_t FIRST_UNPRIVILEGED = 1024;
+    if (ephemeralPorts == 0) {
+        count = std::min<std::size_t>(count, 65536 - FIRST_UNPRIVILEGED);
+        return static_cast<std::uint16_t>(65536 - count);
+    }
+    std::size_t below = firstEphemeralPort > FIRST_UNPRIVILEGED ? firstEphemeralPort - FIRST_UNPRIVILEGED : 0;
+    std::size_t above = 65535 - static_cast<std::size_t>(lastEphemeralPort);
+    if (count > below && count > above) {
+        count = std::max(below, above);
+    }
+    if (count == 0) {
+        return 0;
+    }
+    return static_cast<std::uint16_t>(count <= below ? firstEphemeralPort - count : lastEphemeralPort + 1);
+}
+
+void closeAbortively(boost::asio::ip::tcp::socket& socket) {
+    boost::system::error_code ignore;
+    socket.set_option(boost::asio::socket_base::linger(true, 0), ignore);
+    socket.close(ignore);
+}
+
+boost::system::error_code bindSource(boost::asio::ip::tcp::socket& socket, const boost::asio::ip::tcp& protocol,
+    const boost::asio::ip::address& source) {
+    /**
+     * @brief Prepares a probe socket to connect from `source`.
+     *
+     * Binding picks the local port right away unless IP_BIND_ADDRESS_NO_PORT is set, which would
+     * make the ephemeral range a hard cap per source address; with it the kernel picks the port
+     * at connect time and may reuse it towards other destinations.
+     *
+     * @param socket A closed socket; it is left open on success.
+     * @param protocol The protocol of the endpoint about to be connected to.
+     * @param source A local address of the same family.
+     * @return The error of opening or binding the socket, if any.
+     */
+    boost::system::error_code ec;
+    socket.open(protocol, ec);
+    if (ec) {
+        return ec;
+    }
+#ifdef __linux__
+    int enable = 1;
+    ::setsockopt(socket.native_handle(), IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &enable, sizeof(enable));
+#endif
+    socket.bind(boost::asio::ip::tcp::endpoint(source, 0), ec);
+    if (ec) {
+        boost::system::error_code ignore;
+        socket.close(ignore);
+    }
+    return ec;
+}
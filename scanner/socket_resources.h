@@ -0,0 +1,36 @@
+#pragma once
+#include <boost/asio.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// How many sockets the operating system lets the scan have open at once. Every connect probe
+// holds a file descriptor, and on Linux a local port from `ip_local_port_range` too (per
+// source address), so `maxConnections` beyond either only buys EAGAIN and EADDRNOTAVAIL errors.
+struct SocketBudget {
+    // Open file descriptors allowed, 0 if unknown or unlimited.
+    std::size_t fileLimit = 0;
+    // Size of the ephemeral port range, 0 if unknown.
+    std::size_t ephemeralPorts = 0;
+    // First and last port of the ephemeral range, both 0 if unknown.
+    std::uint16_t firstEphemeralPort = 0;
+    std::uint16_t lastEphemeralPort = 0;
+
+    // Reads the limits of this process, first raising its open file limit to the hard limit.
+    static SocketBudget read();
+    // The most of `connections` that fit, leaving `reservedFiles` descriptors for everything
+    // else and giving each of `sourceCount` source addresses its own ephemeral ports.
+    int fit(int connections, std::size_t reservedFiles, std::size_t sourceCount) const;
+    // The first of `count` consecutive unprivileged ports outside the ephemeral range, lowering
+    // `count` to the widest gap when they don't fit; 0 if there is no gap at all.
+    std::uint16_t portsOutsideEphemeral(std::size_t& count) const;
+};
+
+// Closes a connected socket with a reset instead of a FIN, so it doesn't linger in TIME_WAIT
+// holding its local port.
+void closeAbortively(boost::asio::ip::tcp::socket& socket);
+
+// Opens `socket` for `protocol` and binds it to `source`, leaving the port to the connect on
+// Linux so a source address isn't limited to one connection per local port.
+boost::system::error_code bindSource(boost::asio::ip::tcp::socket& socket, const boost::asio::ip::tcp& protocol,
+    const boost::asio::ip::address& source);
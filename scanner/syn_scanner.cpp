@@ -0,0 +1,430 @@
+#include "syn_scanner.h"
+#include "scanner.h"
+#include "socket_resources.h"
+
+#include <random>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr std::uint8_t TCP_FLAG_SYN = 0x02;
+    constexpr std::uint8_t TCP_FLAG_RST = 0x04;
+    constexpr std::uint8_t TCP_FLAG_ACK = 0x10;
+    // 20 byte TCP header plus a 4 byte MSS option, like a regular connect would send.
+    constexpr std::size_t SYN_LENGTH = 24;
+
+    std::uint16_t tcpChecksum(std::uint32_t source, std::uint32_t destination, const std::uint8_t* segment, std::size_t length) {
+        /**
+         * @brief Computes the TCP checksum over the IPv4 pseudo header and the segment.
+         *
+         * @param source The source address in host byte order.
+         * @param destination The destination address in host byte order.
+         * @param segment The TCP header and payload, with the checksum field zeroed.
+         * @param length The length of `segment` in bytes.
+         * @return The checksum in network byte order.
+         */
+        std::uint32_t sum = 0;
+        sum += (source >> 16) + (source & 0xFFFF);
+        sum += (destination >> 16) + (destination & 0xFFFF);
+        sum += 6; // IPPROTO_TCP
+        sum += static_cast<std::uint32_t>(length);
+        for (std::size_t i = 0; i + 1 < length; i += 2) {
+            sum += (static_cast<std::uint32_t>(segment[i]) << 8) | segment[i + 1];
+        }
+        if (length & 1) {
+            sum += static_cast<std::uint32_t>(segment[length - 1]) << 8;
+        }
+        while (sum >> 16) {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+        std::uint16_t checksum = static_cast<std::uint16_t>(~sum);
+        return static_cast<std::uint16_t>((checksum >> 8) | (checksum << 8));
+    }
+
+    std::uint32_t readUint32(const std::uint8_t* data) {
+        return (static_cast<std::uint32_t>(data[0]) << 24) | (static_cast<std::uint32_t>(data[1]) << 16)
+            | (static_cast<std::uint32_t>(data[2]) << 8) | data[3];
+    }
+
+    std::uint16_t readUint16(const std::uint8_t* data) {
+        return static_cast<std::uint16_t>((data[0] << 8) | data[1]);
+    }
+
+    void writeUint32(std::uint8_t* data, std::uint32_t value) {
+        data[0] = static_cast<std::uint8_t>(value >> 24);
+        data[1] = static_cast<std::uint8_t>(value >> 16);
+        data[2] = static_cast<std::uint8_t>(value >> 8);
+        data[3] = static_cast<std::uint8_t>(value);
+    }
+
+    void writeUint16(std::uint8_t* data, std::uint16_t value) {
+        data[0] = static_cast<std::uint8_t>(value >> 8);
+        data[1] = static_cast<std::uint8_t>(value);
+    }
+}
+
+SynScanner::SynScanner(Scanner& scanner, ScanShard& shard)
+    : scanner(scanner),
+    shard(shard),
+    rawSocket(-1),
+    basePort(0),
+    secret(std::random_device{}()),
+    slotCount(0),
+    inFlight(0),
+    stopReceiving(false)
+{
+}
+
+SynScanner::~SynScanner() {
+#ifdef __linux__
+    if (rawSocket >= 0) {
+        close(rawSocket);
+    }
+#endif
+}
+
+bool SynScanner::isSupported() {
+    /**
+     * @brief True when the raw socket engine is available on this platform (Linux only).
+     */
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::uint32_t SynScanner::cookie(std::uint32_t address, int port) const {
+    /**
+     * @brief Derives the initial sequence number for a destination from a per-scan secret.
+     *
+     * Replies that do not acknowledge it (plus the slot generation) are ignored, which filters
+     * out stray and spoofed segments without keeping any per-probe lookup table.
+     *
+     * @param address The destination address in host byte order.
+     * @param port The destination port.
+     * @return The 32 bit cookie.
+     */
+    std::uint64_t x = (static_cast<std::uint64_t>(address) << 16) ^ static_cast<std::uint64_t>(port) ^ (static_cast<std::uint64_t>(secret) << 32);
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return static_cast<std::uint32_t>(x);
+}
+
+bool SynScanner::takeFreeSlot(std::uint16_t& slotIndex) {
+    std::lock_guard<std::mutex> lock(freeSlotsMutex);
+    if (freeSlots.empty()) {
+        return false;
+    }
+    slotIndex = freeSlots.back();
+    freeSlots.pop_back();
+    return true;
+}
+
+void SynScanner::returnSlot(std::uint16_t slotIndex) {
+    shard.probeSource.finish(slotIndex);
+    std::lock_guard<std::mutex> lock(freeSlotsMutex);
+    freeSlots.push_back(slotIndex);
+}
+
+std::uint32_t SynScanner::sourceAddressFor(std::uint32_t destination) {
+    /**
+     * @brief Asks the routing table which local address reaches a destination.
+     *
+     * The address is needed for the TCP checksum. Connecting a UDP socket sends nothing, it
+     * only makes the kernel pick a route. The answer is cached per /24 so large ranges don't
+     * need a lookup for every address. Only called from the sending thread.
+     *
+     * @param destination The target address in host byte order.
+     * @return The source address in host byte order, or 0 if the destination can't be routed.
+     */
+    std::uint32_t subnet = destination & 0xFFFFFF00;
+    auto cached = sourceAddresses.find(subnet);
+    if (cached != sourceAddresses.end()) {
+        return cached->second;
+    }
+    boost::asio::ip::address_v4 address(destination);
+    std::uint32_t source = 0;
+    boost::system::error_code ec;
+    boost::asio::ip::udp::socket probe(shard.executor);
+    probe.connect(boost::asio::ip::udp::endpoint(address, 9), ec);
+    if (!ec) {
+        boost::asio::ip::udp::endpoint local = probe.local_endpoint(ec);
+        if (!ec) {
+            source = local.address().to_v4().to_uint();
+        }
+    }
+    if (!source) {
+        scanner.logger->warn("No route to {}/24, it will be skipped by the SYN scan ({})", boost::asio::ip::address_v4(subnet).to_string(), ec.message());
+    }
+    sourceAddresses.emplace(subnet, source);
+    return source;
+}
+
+bool SynScanner::sendSyn(std::uint16_t slotIndex, std::uint32_t sequence) {
+    /**
+     * @brief Crafts and sends the SYN for a slot.
+     *
+     * The source port is `basePort + slotIndex`, so a reply leads straight back to its slot.
+     *
+     * @param slotIndex The slot holding the destination.
+     * @param sequence The sequence number to send.
+     * @return false if the kernel refused the packet.
+     */
+#ifdef __linux__
+    Slot& slot = slots[slotIndex];
+    std::uint8_t segment[SYN_LENGTH] = {};
+    writeUint16(segment, static_cast<std::uint16_t>(basePort + slotIndex));
+    writeUint16(segment + 2, static_cast<std::uint16_t>(slot.port));
+    writeUint32(segment + 4, sequence);
+    segment[12] = static_cast<std::uint8_t>((SYN_LENGTH / 4) << 4);
+    segment[13] = TCP_FLAG_SYN;
+    writeUint16(segment + 14, 1024);
+    // MSS option
+    segment[20] = 2;
+    segment[21] = 4;
+    writeUint16(segment + 22, 1460);
+    std::uint16_t checksum = tcpChecksum(slot.sourceAddress, slot.address, segment, SYN_LENGTH);
+    std::memcpy(segment + 16, &checksum, sizeof(checksum));
+
+    sockaddr_in destination{};
+    destination.sin_family = AF_INET;
+    destination.sin_addr.s_addr = htonl(slot.address);
+    return sendto(rawSocket, segment, SYN_LENGTH, 0, reinterpret_cast<sockaddr*>(&destination), sizeof(destination)) == static_cast<ssize_t>(SYN_LENGTH);
+#else
+    return false;
+#endif
+}
+
+void SynScanner::handleSegment(std::uint32_t sourceAddress, const std::uint8_t* tcp, std::size_t length) {
+    /**
+     * @brief Matches a received TCP segment against the outstanding SYNs.
+     *
+     * The destination port identifies the slot and the acknowledgement number carries the slot
+     * generation, so claiming the probe is a single compare and swap. SYN-ACK means open, RST
+     * means closed.
+     *
+     * @param sourceAddress The sender of the segment in host byte order.
+     * @param tcp The TCP header.
+     * @param length The amount of bytes available at `tcp`.
+     */
+    if (length < 20) {
+        return;
+    }
+    std::uint8_t flags = tcp[13];
+    if (!(flags & TCP_FLAG_ACK) || !(flags & (TCP_FLAG_SYN | TCP_FLAG_RST))) {
+        return;
+    }
+    std::uint16_t sourcePort = readUint16(tcp);
+    std::uint16_t destinationPort = readUint16(tcp + 2);
+    if (destinationPort < basePort || static_cast<std::size_t>(destinationPort - basePort) >= slotCount) {
+        return;
+    }
+    std::uint16_t slotIndex = static_cast<std::uint16_t>(destinationPort - basePort);
+    std::uint32_t generation = readUint32(tcp + 8) - 1 - cookie(sourceAddress, sourcePort);
+    std::uint64_t expected = (static_cast<std::uint64_t>(generation) << 1) | 1;
+    Slot& slot = slots[slotIndex];
+    if (!slot.state.compare_exchange_strong(expected, expected & ~1ULL, std::memory_order_acq_rel)) {
+        return;
+    }
+    inFlight.fetch_sub(1);
+    scanner.metrics->onCompleted();
+
+    auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - slot.sentAt);
+    scanner.recordResponse(shard, slot.targetIndex, rtt, (flags & TCP_FLAG_SYN) ? PortState::Open : PortState::Closed);
+    if (flags & TCP_FLAG_SYN) {
+        scanner.updateDictionary(shard, slot.targetIndex, PortInfo(slot.port, PortState::Open));
+    }
+    else if (scanner.displayClosedPorts) {
+        scanner.updateDictionary(shard, slot.targetIndex, PortInfo(slot.port, PortState::Closed));
+    }
+    returnSlot(slotIndex);
+}
+
+void SynScanner::receiveLoop() {
+    /**
+     * @brief Reads IPv4/TCP packets off the raw socket until the scan is finished.
+     *
+     * A short receive timeout lets the loop notice `stopReceiving` even when nothing arrives.
+     */
+#ifdef __linux__
+    std::uint8_t packet[4096];
+    while (!stopReceiving.load()) {
+        ssize_t received = recv(rawSocket, packet, sizeof(packet), 0);
+        if (received < 20) {
+            continue;
+        }
+        std::size_t headerLength = static_cast<std::size_t>(packet[0] & 0x0F) * 4;
+        if ((packet[0] >> 4) != 4 || packet[9] != IPPROTO_TCP || headerLength >= static_cast<std::size_t>(received)) {
+            continue;
+        }
+        handleSegment(readUint32(packet + 12), packet + headerLength, static_cast<std::size_t>(received) - headerLength);
+    }
+#endif
+}
+
+int SynScanner::reclaimExpired() {
+    /**
+     * @brief Gives up on SYNs that ran past their deadline.
+     *
+     * Unanswered probes are handled like a timed out connect: deferred to a retry pass if one
+     * is left, otherwise not recorded. Either way they shrink the congestion window.
+     *
+     * @return The amount of slots that were freed.
+     */
+    auto now = std::chrono::steady_clock::now();
+    int reclaimed = 0;
+    for (std::size_t i = 0; i < slotCount; ++i) {
+        Slot& slot = slots[i];
+        std::uint64_t state = slot.state.load(std::memory_order_acquire);
+        if (!(state & 1) || now < slot.deadline) {
+            continue;
+        }
+        if (slot.state.compare_exchange_strong(state, state & ~1ULL, std::memory_order_acq_rel)) {
+            inFlight.fetch_sub(1);
+            scanner.metrics->onCompleted();
+            scanner.recordUnanswered(shard, slot.targetIndex, slot.port);
+            returnSlot(static_cast<std::uint16_t>(i));
+            reclaimed++;
+        }
+    }
+    return reclaimed;
+}
+
+bool SynScanner::run() {
+    /**
+     * @brief Runs the SYN scan over the scanner's probe source.
+     *
+     * The calling thread sends SYNs while a receive thread matches the replies. At most one SYN
+     * per slot is outstanding and the congestion window caps how many slots are used, so the
+     * engine adapts the same way the connect engine does. Returns once every SYN has been
+     * answered or has timed out.
+     *
+     * @return false if the raw socket could not be opened (missing CAP_NET_RAW).
+     */
+#ifdef __linux__
+    auto& logger = scanner.logger;
+    rawSocket = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+    if (rawSocket < 0) {
+        logger->error("Unable to open a raw socket for the SYN scan ({}); it needs root or CAP_NET_RAW", std::strerror(errno));
+        return false;
+    }
+    timeval receiveTimeout{ 0, 100000 };
+    setsockopt(rawSocket, SOL_SOCKET, SO_RCVTIMEO, &receiveTimeout, sizeof(receiveTimeout));
+    int receiveBuffer = 8 * 1024 * 1024;
+    setsockopt(rawSocket, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+
+    std::size_t wanted = static_cast<std::size_t>(std::clamp(shard.timingTemplate.maxConnections, 1, 16384));
+    slotCount = wanted;
+    basePort = SocketBudget::read().portsOutsideEphemeral(slotCount);
+    if (basePort == 0) {
+        logger->error("The ephemeral port range leaves no source ports free for the SYN scan");
+        return false;
+    }
+    if (slotCount < wanted) {
+        logger->warn("Only {} source ports lie outside the ephemeral port range; the SYN scan keeps at most that many probes in flight", slotCount);
+    }
+    slots = std::make_unique<Slot[]>(slotCount);
+    freeSlots.clear();
+    for (std::size_t i = slotCount; i > 0; --i) {
+        freeSlots.push_back(static_cast<std::uint16_t>(i - 1));
+    }
+    logger->debug("[SynScanner::run] Sending from ports {}-{} with {} slots", basePort, basePort + slotCount - 1, slotCount);
+
+    std::thread receiver([this]() { receiveLoop(); });
+
+    while (true) {
+        std::uint16_t slotIndex;
+        if (inFlight.load() >= shard.congestionWindow.size() || !takeFreeSlot(slotIndex)) {
+            if (reclaimExpired() == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            continue;
+        }
+        std::optional<Probe> probe = shard.probeSource.next(slotIndex);
+        if (!probe) {
+            returnSlot(slotIndex);
+            break;
+        }
+        if (scanner.targets.stateAt(probe->targetIndex) == TargetSpace::HostState::Pending) {
+            // Domains come last in the walk, so by now only lookups are left to wait for
+            // (in a shuffled order this waits for every lookup at the first domain).
+            scanner.resolver->join();
+        }
+        if (scanner.targets.stateAt(probe->targetIndex) == TargetSpace::HostState::Failed || scanner.isDiscovered(probe->targetIndex)) {
+            returnSlot(slotIndex);
+            continue;
+        }
+        boost::asio::ip::address target = scanner.targets.addressAt(probe->targetIndex);
+        if (!target.is_v4()) {
+            if (skippedTargets.insert(probe->targetIndex).second) {
+                scanner.logger->warn("{} is not an IPv4 address, it will be skipped by the SYN scan", scanner.targets.at(probe->targetIndex).prettyName);
+            }
+            returnSlot(slotIndex);
+            continue;
+        }
+        std::uint32_t address = target.to_v4().to_uint();
+        std::uint32_t source = sourceAddressFor(address);
+        if (!source) {
+            returnSlot(slotIndex);
+            continue;
+        }
+
+        // The sender is the only thread sending, so the rate caps are applied by sleeping until
+        // the probe's send time.
+        std::this_thread::sleep_until(scanner.reserveSend(probe->targetIndex));
+
+        Slot& slot = slots[slotIndex];
+        std::uint32_t generation = static_cast<std::uint32_t>(slot.state.load(std::memory_order_relaxed) >> 1) + 1;
+        slot.targetIndex = probe->targetIndex;
+        slot.port = probe->port;
+        slot.address = address;
+        slot.sourceAddress = source;
+        slot.sentAt = std::chrono::steady_clock::now();
+        slot.deadline = slot.sentAt + scanner.probeTimeout(probe->targetIndex);
+        inFlight.fetch_add(1);
+        scanner.metrics->onSent();
+        slot.state.store((static_cast<std::uint64_t>(generation) << 1) | 1, std::memory_order_release);
+
+        int attempts = 3;
+        bool isSent = false;
+        while (!(isSent = sendSyn(slotIndex, cookie(address, probe->port) + generation)) && attempts-- > 0) {
+            // ENOBUFS/EAGAIN: the transmit queue is full, slow down and try again.
+            scanner.recordResourceExhausted(shard);
+            scanner.metrics->retries.fetch_add(1, std::memory_order_relaxed);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (!isSent) {
+            // Nothing went out, so free the slot now and leave the probe to a retry pass
+            // instead of holding the slot until its deadline.
+            slot.state.store(static_cast<std::uint64_t>(generation) << 1, std::memory_order_release);
+            inFlight.fetch_sub(1);
+            scanner.metrics->onCompleted();
+            scanner.deferProbe(shard, probe->targetIndex, probe->port, true);
+            returnSlot(slotIndex);
+        }
+    }
+
+    while (inFlight.load() > 0) {
+        if (reclaimExpired() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    stopReceiving.store(true);
+    receiver.join();
+    return true;
+#else
+    scanner.logger->error("The SYN scan is only supported on Linux");
+    return false;
+#endif
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Scanner;
+struct ScanShard;
+
+// Half-open (SYN) scan engine for Linux. Crafts SYN packets on a raw socket and matches
+// the SYN-ACK / RST replies on a receive thread, feeding the results into the shard's
+// result store. Needs CAP_NET_RAW.
+class SynScanner {
+public:
+    SynScanner(Scanner& scanner, ScanShard& shard);
+    ~SynScanner();
+
+    // True when the engine was built for this platform.
+    static bool isSupported();
+    // Scans everything in the shard's probe source; returns false if the raw socket could not be opened.
+    bool run();
+
+private:
+    // One outstanding SYN. The low bit of `state` marks it in flight, the rest is a generation
+    // counter that is also folded into the sequence number so replies can claim it lock-free.
+    struct Slot {
+        std::atomic<std::uint64_t> state{ 0 };
+        std::size_t targetIndex = 0;
+        int port = 0;
+        std::uint32_t address = 0;
+        std::uint32_t sourceAddress = 0;
+        std::chrono::steady_clock::time_point sentAt;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    // The local address the kernel would use to reach `destination`, 0 if it has no route.
+    std::uint32_t sourceAddressFor(std::uint32_t destination);
+    // Builds and sends a SYN for the probe held by `slotIndex`.
+    bool sendSyn(std::uint16_t slotIndex, std::uint32_t sequence);
+    // Reads replies until `stopReceiving` is set.
+    void receiveLoop();
+    // Matches a TCP segment against the outstanding probes.
+    void handleSegment(std::uint32_t sourceAddress, const std::uint8_t* tcp, std::size_t length);
+    // Frees probes that ran past their deadline; returns how many were freed.
+    int reclaimExpired();
+    // Takes a slot off the free list, or returns false if none is free.
+    bool takeFreeSlot(std::uint16_t& slotIndex);
+    // Marks the slot's probe as finished and puts the slot back on the free list.
+    void returnSlot(std::uint16_t slotIndex);
+    // The sequence number cookie for a destination; replies must acknowledge cookie + generation + 1.
+    std::uint32_t cookie(std::uint32_t address, int port) const;
+
+    Scanner& scanner;
+    ScanShard& shard;
+    int rawSocket;
+    std::uint16_t basePort;
+    std::uint32_t secret;
+    // Source address per destination /24, filled in as the scan reaches new subnets.
+    std::unordered_map<std::uint32_t, std::uint32_t> sourceAddresses;
+    // The targets skipped for not being IPv4, so each is only warned about once.
+    std::unordered_set<std::size_t> skippedTargets;
+    std::unique_ptr<Slot[]> slots;
+    std::size_t slotCount;
+    std::vector<std::uint16_t> freeSlots;
+    std::mutex freeSlotsMutex;
+    std::atomic<int> inFlight;
+    std::atomic<bool> stopReceiving;
+};
@@ -0,0 +1,157 @@
+#include "timing.h"
+
+#include <algorithm>
+#include <cmath>
+
+TimingTemplate TimingTemplate::forLevel(int timing) {
+    /**
+     * @brief Fetches the starting values and bounds for a `-T` level.
+     *
+     * The connection counts and initial timeouts are the values the fixed templates used to
+     * hard-code; the adaptive timing is only allowed to move between the minimum and maximum.
+     *
+     * @param timing The timing level from 0-6.
+     * @return The matching TimingTemplate.
+     */
+    using std::chrono::milliseconds;
+    switch (timing) {
+    // Snail speed..... (5 years later...)
+    case 0:  return { 5,    1,   5,    milliseconds(8000), milliseconds(1000), milliseconds(8000) };
+    case 1:  return { 100,  10,  100,  milliseconds(7000), milliseconds(500),  milliseconds(7000) };
+    case 2:  return { 1000, 50,  1000, milliseconds(6000), milliseconds(250),  milliseconds(6000) };
+    // Consistent, and fast results.
+    case 3:  return { 2000, 100, 2000, milliseconds(8000), milliseconds(100),  milliseconds(8000) };
+    case 4:  return { 3000, 150, 3000, milliseconds(3000), milliseconds(50),   milliseconds(3000) };
+    case 5:  return { 4000, 200, 4000, milliseconds(2000), milliseconds(30),   milliseconds(2000) };
+    // Racecar, probably will display False positives
+    case 6:
+    default: return { 5000, 250, 5000, milliseconds(2000), milliseconds(20),   milliseconds(2000) };
+    }
+}
+
+TimingTemplate TimingTemplate::share(std::size_t parts) const {
+    /**
+     * @brief Splits the connection counts evenly between independent shards.
+     *
+     * Every shard keeps at least one connection, and the timeouts are left untouched since
+     * they don't depend on how many shards are running.
+     *
+     * @param parts The amount of shards sharing the budget.
+     * @return The template each shard should use.
+     */
+    TimingTemplate shared = *this;
+    int divisor = static_cast<int>(std::max<std::size_t>(1, parts));
+    shared.initialConnections = std::max(1, initialConnections / divisor);
+    shared.minConnections = std::max(1, minConnections / divisor);
+    shared.maxConnections = std::max(1, maxConnections / divisor);
+    return shared;
+}
+
+TimingTemplate TimingTemplate::limit(int connections) const {
+    /**
+     * @brief Lowers the connection counts to fit a budget the system can actually provide.
+     *
+     * @param connections The most connections allowed, at least one.
+     * @return The template with every connection count capped at `connections`.
+     */
+    TimingTemplate limited = *this;
+    limited.maxConnections = std::max(1, std::min(maxConnections, connections));
+    limited.initialConnections = std::min(initialConnections, limited.maxConnections);
+    limited.minConnections = std::min(minConnections, limited.maxConnections);
+    return limited;
+}
+
+void RttEstimator::addSample(std::chrono::microseconds rtt) {
+    /**
+     * @brief Updates the smoothed round trip time and its variance with a new measurement.
+     *
+     * @param rtt The time between starting the connect and it completing.
+     */
+    double sample = static_cast<double>(rtt.count());
+    std::lock_guard<std::mutex> lock(estimatorMutex);
+    if (!seeded) {
+        srtt = sample;
+        rttvar = sample / 2.0;
+        seeded = true;
+        return;
+    }
+    rttvar = 0.75 * rttvar + 0.25 * std::abs(srtt - sample);
+    srtt = 0.875 * srtt + 0.125 * sample;
+}
+
+std::chrono::milliseconds RttEstimator::timeout(const TimingTemplate& timingTemplate) {
+    /**
+     * @brief Derives a connect deadline from the estimates.
+     *
+     * @param timingTemplate Supplies the bounds, and the value used before any sample exists.
+     * @return srtt + 4 * rttvar in milliseconds, clamped to the template bounds.
+     */
+    std::lock_guard<std::mutex> lock(estimatorMutex);
+    if (!seeded) {
+        return timingTemplate.initialTimeout;
+    }
+    auto rto = std::chrono::milliseconds(static_cast<long long>(std::ceil((srtt + 4.0 * rttvar) / 1000.0)));
+    return std::clamp(rto, timingTemplate.minTimeout, timingTemplate.maxTimeout);
+}
+
+void CongestionWindow::onResponse() {
+    /**
+     * @brief Opens the window after a probe was answered.
+     *
+     * Grows by one probe per answer below the threshold, and by roughly one probe per
+     * window worth of answers above it.
+     */
+    std::lock_guard<std::mutex> lock(windowMutex);
+    int previous = static_cast<int>(window);
+    completionsSinceDecrease++;
+    window += (window < threshold) ? 1.0 : 1.0 / window;
+    window = std::min(window, maximum);
+    if (static_cast<int>(window) != previous) {
+        limiter.setCapacity(static_cast<int>(window));
+    }
+}
+
+bool CongestionWindow::onTimeout() {
+    /**
+     * @brief Gently shrinks the window after a probe timed out.
+     *
+     * A timeout may just be a filtered port, so it only costs a quarter of the window.
+     */
+    return decrease(0.75);
+}
+
+bool CongestionWindow::onResourceExhausted() {
+    /**
+     * @brief Halves the window after the kernel ran out of sockets or ports.
+     */
+    return decrease(0.5);
+}
+
+bool CongestionWindow::decrease(double factor) {
+    /**
+     * @brief Shrinks the window by `factor`.
+     *
+     * Only one decrease is applied per window worth of completions, so a burst of timeouts
+     * from probes that were all sent together does not collapse the window to its minimum.
+     *
+     * @param factor The multiplier applied to the window.
+     * @return true if the window was shrunk.
+     */
+    std::lock_guard<std::mutex> lock(windowMutex);
+    if (completionsSinceDecrease++ < static_cast<int>(window)) {
+        return false;
+    }
+    completionsSinceDecrease = 0;
+    window = std::max(window * factor, minimum);
+    threshold = window;
+    limiter.setCapacity(static_cast<int>(window));
+    return true;
+}
+
+int CongestionWindow::size() {
+    /**
+     * @brief The current window rounded down to whole probes.
+     */
+    std::lock_guard<std::mutex> lock(windowMutex);
+    return static_cast<int>(window);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+#include "connection_limiter.h"
+
+// Starting values and bounds for the adaptive timing, selected with `-T`.
+struct TimingTemplate {
+    int initialConnections;
+    int minConnections;
+    int maxConnections;
+    std::chrono::milliseconds initialTimeout;
+    std::chrono::milliseconds minTimeout;
+    std::chrono::milliseconds maxTimeout;
+
+    // Fetches the template for the provided timing level (0-6).
+    static TimingTemplate forLevel(int timing);
+    // The connection budget of each of `parts` shards that split this template between them.
+    TimingTemplate share(std::size_t parts) const;
+    // This template with at most `connections` connections.
+    TimingTemplate limit(int connections) const;
+};
+
+// Smoothed round trip time and variance (RFC 6298) built from connects that got an answer.
+class RttEstimator {
+public:
+    // Feeds the round trip time of a successful or refused connect.
+    void addSample(std::chrono::microseconds rtt);
+    // srtt + 4 * rttvar, clamped to the bounds of the timing template.
+    std::chrono::milliseconds timeout(const TimingTemplate& timingTemplate);
+
+private:
+    std::mutex estimatorMutex;
+    bool seeded = false;
+    double srtt = 0.0;
+    double rttvar = 0.0;
+};
+
+// Grows and shrinks the amount of probes allowed in flight, and applies it to the limiter.
+class CongestionWindow {
+public:
+    CongestionWindow(ConnectionLimiter& limiter, const TimingTemplate& timingTemplate)
+        : limiter(limiter),
+        minimum(timingTemplate.minConnections),
+        maximum(timingTemplate.maxConnections),
+        window(timingTemplate.initialConnections),
+        threshold(timingTemplate.maxConnections),
+        completionsSinceDecrease(0)
+    {
+        limiter.setCapacity(size());
+    }
+
+    // A probe got an answer (open or refused).
+    void onResponse();
+    // A probe ran into its deadline without an answer; returns true if the window shrank.
+    bool onTimeout();
+    // The kernel refused to hand out a socket (EAGAIN); returns true if the window shrank.
+    bool onResourceExhausted();
+    // The current window rounded down to whole probes.
+    int size();
+
+private:
+    // Shrinks the window by `factor`, at most once per window worth of completions.
+    bool decrease(double factor);
+
+    ConnectionLimiter& limiter;
+    std::mutex windowMutex;
+    double minimum;
+    double maximum;
+    double window;
+    double threshold;
+    int completionsSinceDecrease;
+};